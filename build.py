@@ -7,6 +7,7 @@ Supports Linux, Windows (native), and cross-compilation
 import platform
 import subprocess
 import sys
+import tempfile
 from pathlib import Path
 
 
@@ -288,12 +289,14 @@ def build_phase4_windows(cross_compile=False):
     return True
 
 
-def build_phase4_linux(use_zig=True):
+def build_phase4_linux(use_zig=True, extra_flags=None):
     """Build YM2151 log player for Linux."""
     print("\n" + "=" * 60)
     print("Building YM2151 log player for Linux")
     print("=" * 60)
 
+    extra_flags = extra_flags or []
+
     if use_zig:
         if not check_zig():
             return False
@@ -309,7 +312,7 @@ def build_phase4_linux(use_zig=True):
             "-lpthread",
             "-ldl",
             "-fwrapv",
-        ]
+        ] + extra_flags
         if not run_command(cmd, "Building YM2151 log player with zig cc"):
             return False
     else:
@@ -323,7 +326,7 @@ def build_phase4_linux(use_zig=True):
             "-lpthread",
             "-ldl",
             "-fwrapv",
-        ]
+        ] + extra_flags
         if not run_command(cmd, "Building YM2151 log player with gcc"):
             return False
 
@@ -331,6 +334,123 @@ def build_phase4_linux(use_zig=True):
     return True
 
 
+def build_render_lib(use_zig=True):
+    """Build the embeddable render library (static, see src/ym2151_render.h)."""
+    print("\n" + "=" * 60)
+    print("Building YM2151 render library")
+    print("=" * 60)
+
+    if use_zig:
+        if not check_zig():
+            return False
+        cc = ["zig", "cc"]
+        ar = ["zig", "ar"]
+    else:
+        cc = ["gcc"]
+        ar = ["ar"]
+
+    objects = []
+    for source, obj in [("src/ym2151_render.c", "ym2151_render.o"), ("opm.c", "opm.o")]:
+        cmd = cc + ["-c", "-o", obj, source, "-fwrapv", "-O2"]
+        if not run_command(cmd, f"Compiling {source}"):
+            return False
+        objects.append(obj)
+
+    if not run_command(ar + ["rcs", "libym2151render.a"] + objects, "Creating libym2151render.a"):
+        return False
+
+    print("✅ Build successful: libym2151render.a (link with -lm -lpthread)")
+    return True
+
+
+def build_headless_tools(use_zig=True):
+    """Build the headless tools (no audio device backends, see YM2151_HEADLESS in src/types.h)."""
+    print("\n" + "=" * 60)
+    print("Building headless YM2151 tools")
+    print("=" * 60)
+
+    if use_zig and not check_zig():
+        return False
+    cc = ["zig", "cc"] if use_zig else ["gcc"]
+
+    tools = [
+        "test_json_loader",
+        "test_sample_rate",
+        "test_stems",
+        "test_flac",
+        "test_wav_writer",
+        "verify_optimizer",
+        "verify_fast_paths",
+        "bench_event_stream",
+    ]
+    for tool in tools:
+        cmd = cc + ["-o", tool, f"src/{tool}.c", "opm.c", "-lm", "-lpthread", "-fwrapv", "-O2"]
+        if not run_command(cmd, f"Building {tool}"):
+            return False
+
+    if not build_render_lib(use_zig):
+        return False
+    cmd = cc + ["-o", "test_render_lib", "src/test_render_lib.c", "libym2151render.a", "-lm", "-lpthread", "-O2"]
+    if not run_command(cmd, "Building test_render_lib"):
+        return False
+    tools.append("test_render_lib")
+
+    print("✅ Build successful: " + ", ".join(tools))
+    return True
+
+
+def run_tool_checks():
+    """Run the headless tests and equivalence checks on the sample and test logs (build them and the player first)."""
+    print("\n" + "=" * 60)
+    print("Running headless tool checks")
+    print("=" * 60)
+
+    windows = platform.system() == "Windows"
+    checks = [
+        ["test_json_loader", "sample_events.json"],
+        ["test_json_loader", "sample_events_pass1.json"],
+        ["test_sample_rate"],
+        ["test_stems"],
+        ["test_flac"],
+        ["test_wav_writer"],
+        ["verify_optimizer", "sample_events.json"],
+        ["verify_optimizer", "sample_events_pass1.json"],
+        ["verify_optimizer", "test_logs/redundant_writes.json"],
+        ["verify_fast_paths", "test_logs/a4_tone.json", "test_logs/keyon_keyoff.json", "test_logs/lfo_toggle.json"],
+    ]
+    # The render library must match the player's offline render of the same log (rendered in a temporary
+    # directory, the player writes output.wav to the current directory)
+    render_log = "test_logs/keyon_keyoff.json"
+    player = str(Path("player.exe" if windows else "player").resolve())
+    with tempfile.TemporaryDirectory() as render_dir:
+        cmd = [player, "--render", "sequential", str(Path(render_log).resolve())]
+        result = subprocess.run(cmd, cwd=render_dir, capture_output=True, text=True)
+        if result.returncode != 0:
+            print(f"❌ player --render sequential {render_log} failed with exit code {result.returncode}")
+            print(result.stdout)
+            print(result.stderr)
+            return False
+        checks.append(["test_render_lib", render_log, str(Path(render_dir) / "output.wav")])
+
+        for check in checks:
+            cmd = [check[0] + ".exe" if windows else "./" + check[0]] + check[1:]
+            result = subprocess.run(cmd, capture_output=True, text=True)
+            if result.returncode != 0:
+                print(f"❌ {' '.join(check)} failed with exit code {result.returncode}")
+                print(result.stdout)
+                print(result.stderr)
+                return False
+            print(f"✅ {' '.join(check)}")
+    return True
+
+
+def build_player(use_zig=True):
+    """Build the player for the tool checks (offline render of a log, see run_tool_checks)."""
+    if platform.system() == "Windows":
+        return build_phase4_windows(cross_compile=False)
+    return build_phase4_linux(use_zig=use_zig, extra_flags=["-O2"])
+
+
 def run_test():
     """Run the test program."""
     print("\n" + "=" * 60)
@@ -436,6 +556,30 @@ def main():
     elif command == "build-phase4-windows":
         success = build_phase4_windows(cross_compile=(system != "Windows"))
 
+    elif command == "build-phase4-profile":
+        if system != "Linux":
+            print("❌ Error: profile build only supported on Linux")
+            return 1
+        success = build_phase4_linux(use_zig=False, extra_flags=["-O2", "-DOPM_PROFILE"])
+
+    elif command == "build-lib":
+        success = build_render_lib(use_zig=True)
+
+    elif command == "build-lib-gcc":
+        success = build_render_lib(use_zig=False)
+
+    elif command == "build-tools":
+        success = build_headless_tools(use_zig=True)
+
+    elif command == "build-tools-gcc":
+        success = build_headless_tools(use_zig=False)
+
+    elif command == "check-tools":
+        success = build_headless_tools(use_zig=True) and build_player(use_zig=True) and run_tool_checks()
+
+    elif command == "check-tools-gcc":
+        success = build_headless_tools(use_zig=False) and build_player(use_zig=False) and run_tool_checks()
+
     elif command == "test":
         success = run_test()
 
@@ -446,6 +590,13 @@ def main():
         print("  build-phase4         Build YM2151 log player for current platform (recommended)")
         print("  build-phase4-gcc     Build YM2151 log player with gcc (Linux only)")
         print("  build-phase4-windows Build YM2151 log player Windows executable (cross-compile if on Linux)")
+        print("  build-phase4-profile Build YM2151 log player with per-stage OPM_Clock profiling (Linux, gcc)")
+        print("  build-lib            Build the embeddable render library libym2151render.a")
+        print("  build-lib-gcc        Build the render library with gcc")
+        print("  build-tools          Build the headless tools (tests, benchmark, optimizer check)")
+        print("  build-tools-gcc      Build the headless tools with gcc")
+        print("  check-tools          Build the headless tools and the player and run the checks on the logs")
+        print("  check-tools-gcc      Build the headless tools with gcc and run the checks")
         print("  help                 Show this help message")
         print()
         print("Note: Other build commands from ym2151-zig-cc are preserved but not used in this project.")
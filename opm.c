@@ -27,6 +27,76 @@
 #include <stdint.h>
 #include "opm.h"
 
+/* Per-stage profiling (build with -DOPM_PROFILE, compiles to nothing otherwise) */
+#ifdef OPM_PROFILE
+#include <stdio.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define OPM_PROF_NOW() __rdtsc()
+#define OPM_PROF_UNIT "cycles"
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define OPM_PROF_NOW() __rdtsc()
+#define OPM_PROF_UNIT "cycles"
+#else
+#include <time.h>
+static uint64_t OPM_ProfNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#define OPM_PROF_NOW() OPM_ProfNow()
+#define OPM_PROF_UNIT "ns"
+#endif
+
+enum {
+    opm_prof_mixer = 0,
+    opm_prof_operator,
+    opm_prof_envelope,
+    opm_prof_phase,
+    opm_prof_timer,
+    opm_prof_lfo,
+    opm_prof_noise,
+    opm_prof_keyon,
+    opm_prof_io,
+    opm_prof_output,
+    opm_prof_count
+};
+
+static const char *opm_prof_names[opm_prof_count] = {
+    "mixer", "operator", "envelope", "phase", "timer", "lfo", "noise", "keyon", "io", "output"
+};
+
+/* A timestamp read costs about as much as the smaller stages, so only one clock in OPM_PROF_INTERVAL
+ * is timed (the others run without marks) and the calibrated cost of a mark is subtracted in the dump */
+#define OPM_PROF_INTERVAL 16
+
+static uint64_t opm_prof_ticks[opm_prof_count];
+static uint64_t opm_prof_marks[opm_prof_count];
+static uint64_t opm_prof_clocks; /* Timed clocks */
+static uint64_t opm_prof_total_clocks;
+
+#define OPM_PROF_BEGIN() \
+    int opm_prof_on = opm_prof_total_clocks++ % OPM_PROF_INTERVAL == 0; \
+    uint64_t opm_prof_t = opm_prof_on ? OPM_PROF_NOW() : 0, opm_prof_t2
+#define OPM_PROF_MARK(group) \
+    do { \
+        if (opm_prof_on) \
+        { \
+            opm_prof_t2 = OPM_PROF_NOW(); \
+            opm_prof_ticks[opm_prof_##group] += opm_prof_t2 - opm_prof_t; \
+            opm_prof_marks[opm_prof_##group]++; \
+            opm_prof_t = opm_prof_t2; \
+        } \
+    } while (0)
+#define OPM_PROF_END() opm_prof_clocks += opm_prof_on
+#else
+#define OPM_PROF_BEGIN()
+#define OPM_PROF_MARK(group)
+#define OPM_PROF_END()
+#endif
+
 enum {
     eg_num_attack = 0,
     eg_num_decay = 1,
@@ -396,26 +466,54 @@ static int32_t OPM_CalcKCode(int32_t kcf, int32_t lfo, int32_t lfo_sign, int32_t
     return sum;
 }
 
+/* Pitch cache invalidation */
+static void OPM_PitchInvalidateChannel(opm_t *chip, uint32_t channel)
+{
+    chip->pg_fnum_valid[channel] = 0;
+    chip->pg_fnum_valid[channel + 8] = 0;
+    chip->pg_fnum_valid[channel + 16] = 0;
+    chip->pg_fnum_valid[channel + 24] = 0;
+}
+
+static void OPM_PitchInvalidateLFO(opm_t *chip)
+{
+    uint32_t slot;
+    /* Slots with PMS = 0 don't depend on the LFO */
+    for (slot = 0; slot < 32; slot++)
+    {
+        if (chip->ch_pms[slot % 8])
+        {
+            chip->pg_fnum_valid[slot] = 0;
+        }
+    }
+}
+
 static void OPM_PhaseCalcFNumBlock(opm_t *chip)
 {
     uint32_t slot = (chip->cycles + 7) % 32;
     uint32_t channel = slot % 8;
-    uint32_t kcf = (chip->ch_kc[channel] << 6) + chip->ch_kf[channel];
-    uint32_t lfo = chip->lfo_pmd ? chip->lfo_pm_lock : 0;
-    uint32_t pms = chip->ch_pms[channel];
-    uint32_t dt = chip->sl_dt2[slot];
-    int32_t lfo_pm = OPM_LFOApplyPMS(lfo & 127, pms);
-    uint32_t kcode = OPM_CalcKCode(kcf, lfo_pm, (lfo & 0x80) != 0 && pms != 0 ? 0 : 1, dt);
-    uint32_t fnum = OPM_KCToFNum(kcode);
-    uint32_t kcode_h = kcode >> 8;
+    uint32_t kcf, lfo, pms, dt, kcode, fnum;
+    int32_t lfo_pm;
+    if (chip->pg_fnum_valid[slot])
+    {
+        return;
+    }
+    kcf = (chip->ch_kc[channel] << 6) + chip->ch_kf[channel];
+    lfo = chip->lfo_pmd ? chip->lfo_pm_lock : 0;
+    pms = chip->ch_pms[channel];
+    dt = chip->sl_dt2[slot];
+    lfo_pm = OPM_LFOApplyPMS(lfo & 127, pms);
+    kcode = OPM_CalcKCode(kcf, lfo_pm, (lfo & 0x80) != 0 && pms != 0 ? 0 : 1, dt);
+    fnum = OPM_KCToFNum(kcode);
     chip->pg_fnum[slot] = fnum;
-    chip->pg_kcode[slot] = kcode_h;
+    chip->pg_kcode[slot] = kcode >> 8;
+    chip->pg_fnum_valid[slot] = 1;
+    chip->pg_inc_valid[slot] = 0;
 }
 
 static void OPM_PhaseCalcIncrement(opm_t *chip)
 {
     uint32_t slot = chip->cycles;
-    uint32_t channel = slot % 8;
     uint32_t dt = chip->sl_dt1[slot];
     uint32_t dt_l = dt & 3;
     uint32_t detune = 0;
@@ -425,6 +523,12 @@ static void OPM_PhaseCalcIncrement(opm_t *chip)
     uint32_t block = kcode >> 2;
     uint32_t basefreq = (fnum << block) >> 2;
     uint32_t note, sum, sum_h, sum_l, inc;
+    if (chip->pg_inc_valid[slot])
+    {
+        /* pg_inc may have been masked by a phase reset, restore it from the cache */
+        chip->pg_inc[slot] = chip->pg_inc_cache[slot];
+        return;
+    }
     /* Apply detune */
     if (dt_l)
     {
@@ -458,6 +562,8 @@ static void OPM_PhaseCalcIncrement(opm_t *chip)
     }
     inc &= 0xfffff;
     chip->pg_inc[slot] = inc;
+    chip->pg_inc_cache[slot] = inc;
+    chip->pg_inc_valid[slot] = 1;
 }
 
 static void OPM_PhaseGenerate(opm_t *chip)
@@ -646,6 +752,18 @@ static void OPM_EnvelopePhase4(opm_t *chip)
     }
     chip->eg_inc = inc;
 
+    /* Dead slot: released, fully attenuated and not keyed on, so the flags below are constants */
+    if ((chip->fast_paths & OPM_FAST_DEAD_SLOTS) && !chip->kon[slot] && chip->eg_level[slot] == 0x3ff &&
+        chip->eg_state[slot] == eg_num_release && !chip->ic)
+    {
+        chip->pg_reset[slot] = 0;
+        chip->eg_instantattack = 0;
+        chip->eg_mute = 1;
+        chip->eg_inclinear = 0;
+        chip->eg_incattack = 0;
+        return;
+    }
+
     kon = chip->kon[slot] && !chip->kon2[slot];
     chip->pg_reset[slot] = kon;
     chip->eg_instantattack = chip->eg_ratemax[1] && (kon || !chip->eg_ratemax[1]);
@@ -724,26 +842,34 @@ static void OPM_EnvelopePhase5(opm_t *chip)
     uint32_t slot = (chip->cycles + 29) % 32;
     uint32_t level = chip->eg_level[slot];
     uint32_t step = 0;
-    if (chip->eg_instantattack)
-    {
-        level = 0;
-    }
-    if (chip->eg_mute || chip->ic)
+    if ((chip->fast_paths & OPM_FAST_DEAD_SLOTS) && chip->eg_mute)
     {
+        /* Muted slots are off and not attacking, so neither increment applies */
         level = 0x3ff;
     }
-    if (chip->eg_inc)
+    else
     {
-        if (chip->eg_inclinear)
+        if (chip->eg_instantattack)
         {
-            step |= 1 << (chip->eg_inc - 1);
+            level = 0;
         }
-        if (chip->eg_incattack)
+        if (chip->eg_mute || chip->ic)
         {
-            step |= ((~(int32_t)chip->eg_level[slot]) << chip->eg_inc) >> 5;
+            level = 0x3ff;
+        }
+        if (chip->eg_inc)
+        {
+            if (chip->eg_inclinear)
+            {
+                step |= 1 << (chip->eg_inc - 1);
+            }
+            if (chip->eg_incattack)
+            {
+                step |= ((~(int32_t)chip->eg_level[slot]) << chip->eg_inc) >> 5;
+            }
         }
+        level += step;
     }
-    level += step;
     chip->eg_level[slot] = (uint16_t)level;
 
     chip->eg_out[0] = chip->eg_outtemp[1] + (chip->eg_tl[2] << 3);
@@ -1126,12 +1252,21 @@ static void OPM_Output(opm_t *chip)
 static void OPM_DAC(opm_t *chip)
 {
     int32_t exp, mant;
+    uint32_t i;
     if (chip->dac_osh1 && !chip->smp_sh1)
     {
         exp = (chip->dac_bits >> 10) & 7;
         mant = (chip->dac_bits >> 0) & 1023;
         mant -= 512;
         chip->dac_output[1] = (mant << exp) >> 1;
+        // Stems change together with the DAC output they add up to
+        if (chip->stem_enable)
+        {
+            for (i = 0; i < 8; i++)
+            {
+                chip->stem_out[i][1] = chip->stem_serial[i][1];
+            }
+        }
     }
     if (chip->dac_osh2 && !chip->smp_sh2)
     {
@@ -1139,6 +1274,13 @@ static void OPM_DAC(opm_t *chip)
         mant = (chip->dac_bits >> 0) & 1023;
         mant -= 512;
         chip->dac_output[0] = (mant << exp) >> 1;
+        if (chip->stem_enable)
+        {
+            for (i = 0; i < 8; i++)
+            {
+                chip->stem_out[i][0] = chip->stem_serial[i][0];
+            }
+        }
     }
     chip->dac_bits >>= 1;
     chip->dac_bits |= chip->smp_so << 12;
@@ -1150,6 +1292,8 @@ static void OPM_Mixer(opm_t *chip)
 {
     uint32_t slot = (chip->cycles + 18) % 32;
     uint32_t channel = (slot % 8);
+    uint32_t i;
+    int32_t op_mix;
     // Right channel
     chip->mix_serial[1] >>= 1;
     if (chip->cycles == 13)
@@ -1254,8 +1398,36 @@ static void OPM_Mixer(opm_t *chip)
     {
         chip->mix[0] = 0;
     }
-    chip->mix[0] += chip->op_mix * chip->op_mixl;
-    chip->mix[1] += chip->op_mix * chip->op_mixr;
+    // Muted channels are left out of the master mix (stems keep every channel)
+    op_mix = (chip->mute_mask >> channel) & 1 ? 0 : chip->op_mix;
+    chip->mix[0] += op_mix * chip->op_mixl;
+    chip->mix[1] += op_mix * chip->op_mixr;
+
+    // Per-channel copy of the accumulation, latched at the same cycles as mix. A word latched here reaches
+    // the DAC after the next latch (see OPM_DAC), so the previous latch moves on to stem_serial.
+    if (chip->stem_enable)
+    {
+        if (chip->cycles == 13)
+        {
+            for (i = 0; i < 8; i++)
+            {
+                chip->stem_serial[i][1] = chip->stem_latch[i][1];
+                chip->stem_latch[i][1] = chip->stem_mix[i][1];
+                chip->stem_mix[i][1] = 0;
+            }
+        }
+        if (chip->cycles == 29)
+        {
+            for (i = 0; i < 8; i++)
+            {
+                chip->stem_serial[i][0] = chip->stem_latch[i][0];
+                chip->stem_latch[i][0] = chip->stem_mix[i][0];
+                chip->stem_mix[i][0] = 0;
+            }
+        }
+        chip->stem_mix[channel][0] += chip->op_mix * chip->op_mixl;
+        chip->stem_mix[channel][1] += chip->op_mix * chip->op_mixr;
+    }
 }
 
 static void OPM_Noise(opm_t *chip)
@@ -1390,6 +1562,14 @@ static void OPM_DoLFOMult(opm_t *chip)
     uint8_t bit = 0, b1, b2;
     uint8_t sum;
 
+    /* Idle LFO: with AMD = PMD = 0 and an empty product register, the multiplier only adds zeros.
+     * The waveform generator (lfo_val, lfo_out1) keeps running so the LFO phase stays exact. */
+    if ((chip->fast_paths & OPM_FAST_LFO_IDLE) && !chip->lfo_amd && !chip->lfo_pmd && !chip->lfo_out2 &&
+        !chip->lfo_out2_b && !chip->lfo_mult_carry)
+    {
+        return;
+    }
+
     chip->lfo_out2_b = chip->lfo_out2;
 
     switch (chip->lfo_bit_counter & 7)
@@ -1520,8 +1700,12 @@ static void OPM_DoLFO1(opm_t *chip)
     {
         if (ampm_sel)
         {
-            chip->lfo_pm_lock = (chip->lfo_out2_b >> 8) & 255;
-            chip->lfo_pm_lock ^= lfo_pm_sign << 7;
+            uint8_t pm_lock = ((chip->lfo_out2_b >> 8) & 255) ^ (lfo_pm_sign << 7);
+            if (pm_lock != chip->lfo_pm_lock && chip->lfo_pmd)
+            {
+                OPM_PitchInvalidateLFO(chip);
+            }
+            chip->lfo_pm_lock = pm_lock;
         }
         else
         {
@@ -1649,13 +1833,16 @@ static void OPM_DoRegWrite(opm_t *chip)
                 break;
             case 0x08: // KC
                 chip->ch_kc[channel] = chip->reg_data & 0x7f;
+                OPM_PitchInvalidateChannel(chip, channel);
                 break;
             case 0x10: // KF
                 chip->ch_kf[channel] = chip->reg_data >> 2;
+                OPM_PitchInvalidateChannel(chip, channel);
                 break;
             case 0x18: // PMS, AMS
                 chip->ch_pms[channel] = (chip->reg_data >> 4) & 0x07;
                 chip->ch_ams[channel] = chip->reg_data & 0x03;
+                OPM_PitchInvalidateChannel(chip, channel);
                 break;
             default:
                 break;
@@ -1669,6 +1856,7 @@ static void OPM_DoRegWrite(opm_t *chip)
             case 0x40: // DT1, MUL
                 chip->sl_dt1[slot] = (chip->reg_data >> 4) & 0x07;
                 chip->sl_mul[slot] = chip->reg_data & 0x0f;
+                chip->pg_inc_valid[slot] = 0;
                 break;
             case 0x60: // TL
                 chip->sl_tl[slot] = chip->reg_data & 0x7f;
@@ -1684,6 +1872,7 @@ static void OPM_DoRegWrite(opm_t *chip)
             case 0xc0: // DT2, D2R
                 chip->sl_dt2[slot] = chip->reg_data >> 6;
                 chip->sl_d2r[slot] = chip->reg_data & 0x1f;
+                chip->pg_fnum_valid[slot] = 0;
                 break;
             case 0xe0: // D1L, RR
                 chip->sl_d1l[slot] = chip->reg_data >> 4;
@@ -1746,6 +1935,7 @@ static void OPM_DoRegWrite(opm_t *chip)
             if (chip->write_data & 0x80)
             {
                 chip->lfo_pmd = chip->write_data & 0x7f;
+                OPM_PitchInvalidateLFO(chip);
             }
             else
             {
@@ -1844,14 +2034,25 @@ static void OPM_DoIC(opm_t *chip)
 
         chip->reg_address = 0;
         chip->reg_data = 0;
+
+        memset(chip->pg_fnum_valid, 0, sizeof(chip->pg_fnum_valid));
+        memset(chip->pg_inc_valid, 0, sizeof(chip->pg_inc_valid));
     }
     chip->ic2 = chip->ic;
 }
 
+/* One clock of the slot cycle in chip->cycles. A specialized clock was tried and not kept (commit fb1571b,
+ * measured with its bench_event_stream --clock mode). It had 32 copies of this body, one per cycle, so
+ * slot indices and cycle checks became constants, and a whole round ran in a straight line. It measured
+ * 0.96x of this clock with shared slot pipelines and 0.88x fully inlined on a 32 KiB L1i machine. Each copy
+ * is about 3 KB, so a round does not fit in the instruction cache, and the cycle branches it removes are
+ * well predicted. */
 void OPM_Clock(opm_t *chip, int32_t *output, uint8_t *sh1, uint8_t *sh2, uint8_t *so)
 {
+    OPM_PROF_BEGIN();
     OPM_Mixer2(chip);
     OPM_Mixer(chip);
+    OPM_PROF_MARK(mixer);
 
     OPM_OperatorPhase16(chip);
     OPM_OperatorPhase15(chip);
@@ -1870,6 +2071,7 @@ void OPM_Clock(opm_t *chip, int32_t *output, uint8_t *sh1, uint8_t *sh2, uint8_t
     OPM_OperatorPhase2(chip);
     OPM_OperatorPhase1(chip);
     OPM_OperatorCounter(chip);
+    OPM_PROF_MARK(operator);
 
     OPM_EnvelopeTimer(chip);
     OPM_EnvelopePhase6(chip);
@@ -1878,32 +2080,50 @@ void OPM_Clock(opm_t *chip, int32_t *output, uint8_t *sh1, uint8_t *sh2, uint8_t
     OPM_EnvelopePhase3(chip);
     OPM_EnvelopePhase2(chip);
     OPM_EnvelopePhase1(chip);
+    OPM_PROF_MARK(envelope);
 
     OPM_PhaseDebug(chip);
     OPM_PhaseGenerate(chip);
     OPM_PhaseCalcIncrement(chip);
     OPM_PhaseCalcFNumBlock(chip);
+    OPM_PROF_MARK(phase);
 
     OPM_DoTimerIRQ(chip);
     OPM_DoTimerA(chip);
     OPM_DoTimerB(chip);
+    OPM_PROF_MARK(timer);
     OPM_DoLFOMult(chip);
     OPM_DoLFO1(chip);
+    OPM_PROF_MARK(lfo);
     OPM_Noise(chip);
+    OPM_PROF_MARK(noise);
     OPM_KeyOn2(chip);
+    OPM_PROF_MARK(keyon);
     OPM_DoRegWrite(chip);
+    OPM_PROF_MARK(io);
     OPM_EnvelopeClock(chip);
+    OPM_PROF_MARK(envelope);
     OPM_NoiseTimer(chip);
+    OPM_PROF_MARK(noise);
     OPM_KeyOn1(chip);
+    OPM_PROF_MARK(keyon);
     OPM_DoIO(chip);
+    OPM_PROF_MARK(io);
     OPM_DoTimerA2(chip);
     OPM_DoTimerB2(chip);
+    OPM_PROF_MARK(timer);
     OPM_DoLFO2(chip);
+    OPM_PROF_MARK(lfo);
     OPM_CSM(chip);
+    OPM_PROF_MARK(timer);
     OPM_NoiseChannel(chip);
+    OPM_PROF_MARK(noise);
     OPM_Output(chip);
     OPM_DAC(chip);
+    OPM_PROF_MARK(output);
     OPM_DoIC(chip);
+    OPM_PROF_MARK(io);
+    OPM_PROF_END();
     if (sh1)
     {
         *sh1 = chip->smp_sh1;
@@ -1994,6 +2214,7 @@ void OPM_Reset(opm_t *chip)
 {
     uint32_t i;
     memset(chip, 0, sizeof(opm_t));
+    chip->fast_paths = OPM_FAST_ALL;
     OPM_SetIC(chip, 1);
     for (i = 0; i < 32 * 64; i++)
     {
@@ -2001,3 +2222,101 @@ void OPM_Reset(opm_t *chip)
     }
     OPM_SetIC(chip, 0);
 }
+
+void OPM_SetFastPaths(opm_t *chip, uint8_t flags)
+{
+    chip->fast_paths = flags;
+}
+
+void OPM_SetMuteMask(opm_t *chip, uint8_t mask)
+{
+    chip->mute_mask = mask;
+}
+
+void OPM_SetStemCapture(opm_t *chip, uint8_t enable)
+{
+    chip->stem_enable = enable;
+    memset(chip->stem_mix, 0, sizeof(chip->stem_mix));
+    memset(chip->stem_latch, 0, sizeof(chip->stem_latch));
+    memset(chip->stem_serial, 0, sizeof(chip->stem_serial));
+    memset(chip->stem_out, 0, sizeof(chip->stem_out));
+}
+
+// Per-channel mixer sums of the current DAC output, stems[channel * 2 + {0: left, 1: right}]
+void OPM_GetStems(opm_t *chip, int32_t *stems)
+{
+    uint32_t i;
+    for (i = 0; i < 8; i++)
+    {
+        stems[i * 2 + 0] = chip->stem_out[i][0];
+        stems[i * 2 + 1] = chip->stem_out[i][1];
+    }
+}
+
+#ifdef OPM_PROFILE
+void OPM_ProfileReset(void)
+{
+    memset(opm_prof_ticks, 0, sizeof(opm_prof_ticks));
+    memset(opm_prof_marks, 0, sizeof(opm_prof_marks));
+    opm_prof_clocks = 0;
+    opm_prof_total_clocks = 0;
+}
+
+/* Ticks between two back-to-back marks (the smallest of many tries): what every mark adds to its group */
+static uint64_t OPM_ProfileMarkOverhead(void)
+{
+    uint64_t best = UINT64_MAX, t, t2;
+    uint32_t i;
+    for (i = 0; i < 1000; i++)
+    {
+        t = OPM_PROF_NOW();
+        t2 = OPM_PROF_NOW();
+        if (t2 - t < best)
+        {
+            best = t2 - t;
+        }
+    }
+    return best;
+}
+
+void OPM_ProfileDump(const char *json_filename)
+{
+    uint64_t ticks[opm_prof_count];
+    uint64_t total = 0, overhead = OPM_ProfileMarkOverhead(), marks;
+    uint32_t i;
+    FILE *fp;
+    for (i = 0; i < opm_prof_count; i++)
+    {
+        marks = opm_prof_marks[i] * overhead;
+        ticks[i] = opm_prof_ticks[i] > marks ? opm_prof_ticks[i] - marks : 0;
+        total += ticks[i];
+    }
+    printf("OPM_Clock profile (%llu of %llu clocks timed, unit: %s, %llu %s per mark subtracted):\n",
+           (unsigned long long)opm_prof_clocks, (unsigned long long)opm_prof_total_clocks, OPM_PROF_UNIT,
+           (unsigned long long)overhead, OPM_PROF_UNIT);
+    printf("  %-10s %16s %10s %8s\n", "stage", "total", "per clock", "share");
+    for (i = 0; i < opm_prof_count; i++)
+    {
+        printf("  %-10s %16llu %10.2f %7.1f%%\n", opm_prof_names[i], (unsigned long long)ticks[i],
+               opm_prof_clocks ? (double)ticks[i] / opm_prof_clocks : 0.0, total ? 100.0 * ticks[i] / total : 0.0);
+    }
+    if (!json_filename)
+    {
+        return;
+    }
+    fp = fopen(json_filename, "w");
+    if (!fp)
+    {
+        return;
+    }
+    fprintf(fp, "{\n  \"clocks\": %llu,\n  \"total_clocks\": %llu,\n  \"unit\": \"%s\",\n  \"mark_overhead\": %llu,\n  \"stages\": {",
+            (unsigned long long)opm_prof_clocks, (unsigned long long)opm_prof_total_clocks, OPM_PROF_UNIT,
+            (unsigned long long)overhead);
+    for (i = 0; i < opm_prof_count; i++)
+    {
+        fprintf(fp, "%s\n    \"%s\": %llu", i ? "," : "", opm_prof_names[i], (unsigned long long)ticks[i]);
+    }
+    fprintf(fp, "\n  }\n}\n");
+    fclose(fp);
+}
+#endif
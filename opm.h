@@ -118,6 +118,10 @@ typedef struct {
     uint8_t pg_reset[32];
     uint8_t pg_reset_latch[32];
     uint32_t pg_serial;
+    // Pitch cache: fnum/kcode and increment are only recomputed when their inputs change
+    uint8_t pg_fnum_valid[32];
+    uint8_t pg_inc_valid[32];
+    uint32_t pg_inc_cache[32];
 
     // Operator
     uint16_t op_phase_in;
@@ -157,6 +161,19 @@ typedef struct {
     uint8_t mix_clamp_high[2];
     uint8_t mix_out_bit;
 
+    // Bit-exact shortcuts enabled with OPM_SetFastPaths (OPM_FAST_*)
+    uint8_t fast_paths;
+
+    // Channels left out of the mix (bit n = channel n, set with OPM_SetMuteMask)
+    uint8_t mute_mask;
+
+    // Per-channel stems (enabled with OPM_SetStemCapture)
+    uint8_t stem_enable;
+    int32_t stem_mix[8][2];    // Sums of the sample being accumulated
+    int32_t stem_latch[8][2];  // Sums latched together with mix
+    int32_t stem_serial[8][2]; // Sums of the word on its way to the DAC (one latch behind)
+    int32_t stem_out[8][2];    // Sums of the sample the DAC outputs
+
     // Output
     uint8_t smp_so;
     uint8_t smp_sh1;
@@ -261,6 +278,21 @@ uint8_t OPM_ReadCT1(opm_t *chip);
 uint8_t OPM_ReadCT2(opm_t *chip);
 void OPM_SetIC(opm_t *chip, uint8_t ic);
 void OPM_Reset(opm_t *chip);
+/* Fast paths skip work whose result is known; output and chip state are identical with or without
+ * them (see verify_fast_paths.c). OPM_Reset enables all of them. */
+#define OPM_FAST_DEAD_SLOTS 0x01 /* Envelope of released, fully attenuated slots */
+#define OPM_FAST_LFO_IDLE 0x02   /* LFO multiplier while AMD and PMD are 0 */
+#define OPM_FAST_ALL (OPM_FAST_DEAD_SLOTS | OPM_FAST_LFO_IDLE)
+void OPM_SetFastPaths(opm_t *chip, uint8_t flags);
+void OPM_SetMuteMask(opm_t *chip, uint8_t mask);
+void OPM_SetStemCapture(opm_t *chip, uint8_t enable);
+void OPM_GetStems(opm_t *chip, int32_t *stems);
+
+#ifdef OPM_PROFILE
+/* Per-stage profiling counters (global, accumulated over all chips) */
+void OPM_ProfileReset(void);
+void OPM_ProfileDump(const char *json_filename);
+#endif
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,48 @@
+#ifndef AUDIO_CONTEXT_H
+#define AUDIO_CONTEXT_H
+
+#include "events.h"
+#include "event_stream.h"
+#include "latency_stats.h"
+#include "sample_convert.h"
+
+// Emulation state shared by the audio callback, the offline render and the tools
+// The optional playback modules are referenced through struct pointers, so their headers can include this one.
+
+// User data structure for MiniAudio callback
+typedef struct
+{
+    opm_t chip;
+    uint32_t samples_played;
+    uint32_t total_samples;
+    ma_atomic_bool32 is_playing; // Shared with the audio thread, access with ma_atomic_bool32_get/set
+    ma_event playback_done;      // Signaled once by the audio thread when playback finishes
+    ma_resampler resampler;
+    SampleFormat sample_format;
+    ma_format device_format;                              // ma_format_s16 or ma_format_f32 (depends on sample_format)
+    int32_t raw_buffer[INTERNAL_BUFFER_SIZE * 2];         // Raw DAC output of the current callback (stereo)
+    int16_t internal_buffer[INTERNAL_BUFFER_SIZE * 2];    // Stereo buffer (s16 device format)
+    float internal_buffer_f32[INTERNAL_BUFFER_SIZE * 2];  // Stereo buffer (f32 device format)
+    RegisterEventList *events;
+    size_t next_event_index;
+    EventStream *stream;              // Compact event stream (used instead of 'events' when set)
+    EventStreamCursor stream_cursor;
+    struct LiveInput *live;           // Streaming input (used instead of 'events' when set)
+    struct WriteScheduler *scheduler; // Busy-flag write scheduler (used instead of 'events' when set)
+    struct LoopPlayback *loop;        // Loop-point playback (NULL = play the song once)
+    struct Playlist *playlist;        // Gapless playlist (NULL = single log)
+    uint8_t strobe_capture;           // 1 = one sample per DAC latch (sh1 edge) instead of CYCLES_PER_SAMPLE clocks
+    uint8_t strobe_sh1;               // Previous sh1 state in strobe capture mode
+    int32_t *wav_buffer; // Buffer for WAV output
+    size_t wav_buffer_pos;
+    size_t wav_buffer_capacity; // In stereo frames
+    int32_t *stem_buffer;       // Per-channel mixer output, STEM_VALUES_PER_FRAME per frame (NULL = no stems)
+    struct ChannelControl *channels;  // Runtime mute/solo mask (NULL = all channels play)
+    
+    // Timing measurement fields
+    double total_callback_time_ms;  // Total time spent in callbacks
+    uint64_t callback_count;         // Number of callbacks
+    LatencyStats latency;            // Histogram of callback processing times
+} AudioContext;
+
+#endif // AUDIO_CONTEXT_H
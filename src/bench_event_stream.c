@@ -0,0 +1,194 @@
+/* Benchmark: pass2 RegisterEvent array vs compact event stream
+ * Compares memory footprint and sequential dispatch time through process_events_until()
+ * Build: gcc -O2 -o bench_event_stream src/bench_event_stream.c opm.c -lm -lpthread -fwrapv
+ * Usage: ./bench_event_stream [pass1_event_count]   (synthetic log, default 2000000 events)
+ *        ./bench_event_stream --log <json_log_file>
+ *        ./bench_event_stream --startup <program> [runs]   (process startup time, POSIX only)
+ */
+
+#define YM2151_HEADLESS // No audio device: emulation, threads and file IO only
+#include "core.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Synthetic log resembling driver output: bursts of writes at the same time, then a gap
+static RegisterEventList *make_synthetic_pass1(size_t count)
+{
+    RegisterEventList *list = create_event_list();
+    uint32_t time = 0;
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 8 == 0)
+        {
+            time += 100 + (seed >> 20) % 2000;
+        }
+        add_event_with_flag(list, time, (uint8_t)(0x20 + (seed >> 8) % 0xe0), (uint8_t)(seed >> 24), 0);
+    }
+    return list;
+}
+
+// Dispatch all events sample by sample, as the audio callback does
+static double run_dispatch(AudioContext *ctx, uint32_t last_time)
+{
+    double start = now_ms();
+    for (uint32_t sample = 0; sample <= last_time; sample++)
+    {
+        process_events_until(ctx, sample);
+    }
+    return now_ms() - start;
+}
+
+// Spawn a program without arguments (it prints its usage and exits) and report the wall time per run
+static int run_startup_benchmark(const char *program, int runs)
+{
+#ifdef _WIN32
+    (void)program;
+    (void)runs;
+    fprintf(stderr, "❌ Startup benchmark is only available on POSIX systems\n");
+    return 1;
+#else
+    printf("Startup time of %s (%d runs):\n", program, runs);
+    double total_ms = 0.0;
+    double min_ms = 0.0;
+    for (int i = 0; i < runs; i++)
+    {
+        double start = now_ms();
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            int null_fd = open("/dev/null", O_WRONLY);
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+            execl(program, program, (char *)NULL);
+            _exit(127);
+        }
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || (WIFEXITED(status) && WEXITSTATUS(status) == 127))
+        {
+            fprintf(stderr, "❌ Failed to run %s\n", program);
+            return 1;
+        }
+        double elapsed = now_ms() - start;
+        total_ms += elapsed;
+        min_ms = (i == 0 || elapsed < min_ms) ? elapsed : min_ms;
+    }
+    printf("  Mean %.2f ms, min %.2f ms (process start, dynamic linking and usage output)\n", total_ms / runs, min_ms);
+    printf("\n✅ Benchmark complete\n");
+    return 0;
+#endif
+}
+
+static int print_usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [pass1_event_count]\n", program);
+    fprintf(stderr, "       %s --log <json_log_file>\n", program);
+    fprintf(stderr, "       %s --startup <program> [runs]\n", program);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    printf("Event Stream Benchmark\n");
+    printf("======================\n\n");
+
+    if (argc >= 3 && strcmp(argv[1], "--startup") == 0)
+    {
+        int runs = argc >= 4 ? atoi(argv[3]) : 20;
+        return run_startup_benchmark(argv[2], runs > 0 ? runs : 1);
+    }
+
+    RegisterEventList *pass1;
+    if (argc >= 2 && strcmp(argv[1], "--log") == 0)
+    {
+        if (argc != 3)
+        {
+            return print_usage(argv[0]);
+        }
+        pass1 = load_events_json_pass1(argv[2]);
+        if (!pass1)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        size_t count = 2000000;
+        if (argc >= 2)
+        {
+            char *end = NULL;
+            count = (size_t)strtoull(argv[1], &end, 10);
+            if (argc > 2 || argv[1][0] < '0' || argv[1][0] > '9' || *end != '\0' || count == 0)
+            {
+                return print_usage(argv[0]);
+            }
+        }
+        pass1 = make_synthetic_pass1(count);
+        printf("Synthetic log: %zu pass1 events\n", count);
+    }
+
+    double t0 = now_ms();
+    RegisterEventList *pass2 = convert_to_pass2_format(pass1);
+    double convert_ms = now_ms() - t0;
+
+    t0 = now_ms();
+    EventStream *stream = encode_event_stream(pass1);
+    double encode_ms = now_ms() - t0;
+
+    uint32_t last_time = stream->last_sample_time;
+    AudioContext *ctx = (AudioContext *)calloc(1, sizeof(AudioContext));
+    if (!ctx)
+    {
+        fprintf(stderr, "❌ Failed to allocate audio context\n");
+        return 1;
+    }
+
+    // Array dispatch
+    OPM_Reset(&ctx->chip);
+    ctx->events = pass2;
+    ctx->next_event_index = 0;
+    double array_ms = run_dispatch(ctx, last_time);
+    size_t array_dispatched = ctx->next_event_index;
+
+    // Stream dispatch
+    OPM_Reset(&ctx->chip);
+    ctx->stream = stream;
+    event_stream_rewind(stream, &ctx->stream_cursor);
+    double stream_ms = run_dispatch(ctx, last_time);
+    int stream_done = !ctx->stream_cursor.valid;
+
+    size_t array_bytes = pass2->count * sizeof(RegisterEvent);
+    printf("Results (%zu pass2 events, %u samples):\n", pass2->count, last_time + 1);
+    printf("  %-14s %14s %12s %12s\n", "storage", "bytes", "bytes/write", "build ms");
+    printf("  %-14s %14zu %12.2f %12.2f\n", "pass2 array", array_bytes, (double)array_bytes / pass1->count, convert_ms);
+    printf("  %-14s %14zu %12.2f %12.2f\n", "stream", stream->size, (double)stream->size / pass1->count, encode_ms);
+    printf("  Memory ratio: %.2fx smaller\n", stream->size ? (double)array_bytes / stream->size : 0.0);
+    printf("  Dispatch: array %.2f ms, stream %.2f ms (%.2f ns/event vs %.2f ns/event)\n", array_ms, stream_ms,
+           array_ms * 1e6 / pass2->count, stream_ms * 1e6 / pass2->count);
+
+    int ok = array_dispatched == pass2->count && stream_done;
+    free(ctx);
+    free_event_stream(stream);
+    free_event_list(pass2);
+    free_event_list(pass1);
+
+    if (!ok)
+    {
+        fprintf(stderr, "❌ Not all events were dispatched\n");
+        return 1;
+    }
+    printf("\n✅ Benchmark complete\n");
+    return 0;
+}
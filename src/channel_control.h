@@ -0,0 +1,204 @@
+#ifndef CHANNEL_CONTROL_H
+#define CHANNEL_CONTROL_H
+
+#include "types.h"
+
+#ifdef _WIN32
+#include <conio.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Runtime channel mute/solo
+// A command thread reads lines from the console and updates an atomic mute mask (bit n = channel n+1).
+// The audio callback passes the mask to OPM_SetMuteMask at the start of each buffer, so a change is
+// heard within one device period without reloading or resetting anything.
+// Commands: "m <channels>" toggle mute, "s <channels>" solo, "a" play all ("1,3" or "1-4" lists).
+
+#define CHANNEL_MASK_ALL 0xFF // One bit per FM channel
+
+typedef struct ChannelControl
+{
+    ma_atomic_uint32 mute_mask; // Written by the command thread, applied by the audio callback once per buffer
+    ma_thread thread;
+    int thread_started;
+    ma_atomic_bool32 stop;
+} ChannelControl;
+
+// Parse a channel list such as "1,3" or "2-5" (channels 1-8) into a bitmask, returns 0 if invalid
+int parse_channel_list(const char *text, uint8_t *mask)
+{
+    *mask = 0;
+    const char *p = text;
+    while (*p)
+    {
+        while (*p == ' ' || *p == ',')
+            p++;
+        if (!*p || *p == '\n' || *p == '\r')
+        {
+            break;
+        }
+        if (*p < '1' || *p > '8')
+        {
+            return 0;
+        }
+        int first = *p++ - '1';
+        int last = first;
+        if (*p == '-')
+        {
+            p++;
+            if (*p < '1' || *p > '8')
+            {
+                return 0;
+            }
+            last = *p++ - '1';
+        }
+        for (int ch = first; ch <= last; ch++)
+        {
+            *mask |= (uint8_t)(1u << ch);
+        }
+    }
+    return *mask != 0;
+}
+
+static void print_channel_mask(uint32_t mute_mask)
+{
+    printf("🎚  Channels:");
+    for (int ch = 0; ch < 8; ch++)
+    {
+        printf(" %d%s", ch + 1, (mute_mask >> ch) & 1 ? "-" : "+");
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// Apply one command line to the mask
+static void channel_control_command(ChannelControl *control, const char *line)
+{
+    while (*line == ' ')
+        line++;
+    uint32_t mask = ma_atomic_uint32_get(&control->mute_mask);
+    uint8_t channels = 0;
+    if (line[0] == 'a')
+    {
+        mask = 0;
+    }
+    else if ((line[0] == 'm' || line[0] == 's') && parse_channel_list(line + 1, &channels))
+    {
+        mask = line[0] == 'm' ? mask ^ channels : (uint32_t)(CHANNEL_MASK_ALL & ~channels);
+    }
+    else
+    {
+        if (line[0] && line[0] != '\n' && line[0] != '\r')
+        {
+            fprintf(stderr, "⚠️  Unknown command (m <channels>, s <channels>, a): %s", line);
+        }
+        return;
+    }
+    ma_atomic_uint32_set(&control->mute_mask, mask);
+    print_channel_mask(mask);
+}
+
+// Wait up to 100 ms for one complete console line, returns -1 at end of input
+static int channel_control_read_line(char *line, size_t size, size_t *len)
+{
+#ifdef _WIN32
+    // Console keystrokes are polled so the thread can be stopped without a pending read
+    if (!_kbhit())
+    {
+        ma_sleep(100);
+        return 0;
+    }
+    int c = _getche();
+    if (c == '\r')
+    {
+        printf("\n");
+        c = '\n';
+    }
+    if (*len + 1 < size)
+    {
+        line[(*len)++] = (char)c;
+    }
+    return c == '\n';
+#else
+    struct pollfd pfd;
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 100) <= 0)
+    {
+        return 0;
+    }
+    char c;
+    ssize_t n = read(STDIN_FILENO, &c, 1);
+    if (n <= 0)
+    {
+        return -1;
+    }
+    if (*len + 1 < size)
+    {
+        line[(*len)++] = c;
+    }
+    return c == '\n';
+#endif
+}
+
+static ma_thread_result MA_THREADCALL channel_control_thread(void *user_data)
+{
+    ChannelControl *control = (ChannelControl *)user_data;
+    char line[256];
+    size_t len = 0;
+    while (!ma_atomic_bool32_get(&control->stop))
+    {
+        int result = channel_control_read_line(line, sizeof(line), &len);
+        if (result < 0)
+        {
+            break; // stdin closed: keep the current mask
+        }
+        if (result > 0)
+        {
+            line[len] = '\0';
+            channel_control_command(control, line);
+            len = 0;
+        }
+    }
+    return (ma_thread_result)0;
+}
+
+// Set the initial mask (before the audio device starts)
+void channel_control_init(ChannelControl *control, uint8_t mute_mask)
+{
+    memset(control, 0, sizeof(ChannelControl));
+    ma_atomic_uint32_set(&control->mute_mask, mute_mask);
+    if (mute_mask)
+    {
+        print_channel_mask(mute_mask);
+    }
+}
+
+// Start reading commands from the console
+int channel_control_start(ChannelControl *control)
+{
+    if (ma_thread_create(&control->thread, ma_thread_priority_normal, 0, channel_control_thread, control, NULL) !=
+        MA_SUCCESS)
+    {
+        fprintf(stderr, "❌ Failed to start channel control thread\n");
+        return 0;
+    }
+    control->thread_started = 1;
+    printf("Channel control: m <channels> = toggle mute, s <channels> = solo, a = all (then Enter)\n");
+    return 1;
+}
+
+// Stop the command thread (returns within one poll interval)
+void channel_control_stop(ChannelControl *control)
+{
+    if (control->thread_started)
+    {
+        ma_atomic_bool32_set(&control->stop, MA_TRUE);
+        ma_thread_wait(&control->thread);
+        control->thread_started = 0;
+    }
+}
+
+#endif // CHANNEL_CONTROL_H
@@ -0,0 +1,302 @@
+#ifndef EVENT_CACHE_H
+#define EVENT_CACHE_H
+
+#include "events.h"
+#include "json_loader.h"
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// Sidecar cache of parsed logs (opt-in with --cache)
+// Parsing a large JSON log and converting it to pass2 costs more than everything else at startup, and
+// review sessions replay the same logs over and over. After a parse the pass2 event array is saved next
+// to the log as <log>.pass2cache: an EventCacheHeader followed by the raw RegisterEvent array. A later
+// run maps the file and uses the array in place (no parsing, no copy). The cache is used only if the
+// log still has the recorded size and modification time, the format matches this build (version,
+// event size, DELAY_SAMPLES) and the event array matches its hash; otherwise the log is parsed again
+// and the cache rewritten. Without mmap (Windows) the array is read into memory instead.
+// A modification time with whole-second resolution (Windows stat, FAT and some network file systems)
+// can't tell apart two edits in the same second, so then the hash of the log's content is compared too.
+
+// Sidecar cache of a parsed pass2 event array, followed by the RegisterEvent array
+#define EVENT_CACHE_MAGIC "YM2151P2"
+#define EVENT_CACHE_VERSION 2
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;     // sizeof(RegisterEvent)
+    uint32_t delay_samples;  // DELAY_SAMPLES of the pass2 conversion
+    uint32_t loop_flags;     // Bit 0: loop enabled, bit 1: loop end given
+    uint64_t source_size;    // JSON file the events were parsed from
+    int64_t source_mtime_ns;
+    uint64_t event_count;
+    uint32_t loop_start_time;
+    uint32_t loop_end_time;
+    uint64_t loop_start_index;
+    uint64_t loop_end_index;
+    uint64_t payload_hash;   // Hash of the event array
+    uint64_t source_hash;    // Hash of the JSON file (checked when its mtime has whole-second resolution)
+} EventCacheHeader;
+
+#define EVENT_CACHE_SUFFIX ".pass2cache"
+
+#define EVENT_CACHE_HASH_SEED 0xcbf29ce484222325ULL
+
+// 64-bit FNV-1a over 8-byte words (the event array is a multiple of 8 bytes), then the remaining bytes
+// Data can be hashed in pieces as long as all but the last are a multiple of 8 bytes
+static uint64_t event_cache_hash_update(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t event_cache_hash(const void *data, size_t size)
+{
+    return event_cache_hash_update(EVENT_CACHE_HASH_SEED, data, size);
+}
+
+// Hash of a file's content, returns 0 if it can't be read
+static int event_cache_hash_file(const char *filename, uint64_t *hash)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        return 0;
+    }
+    uint8_t buffer[65536];
+    size_t bytes;
+    *hash = EVENT_CACHE_HASH_SEED;
+    while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        *hash = event_cache_hash_update(*hash, buffer, bytes);
+    }
+    int ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
+
+// Whole-second modification times can miss an edit made in the same second as the cache was written
+static int event_cache_mtime_is_coarse(int64_t mtime_ns)
+{
+    return mtime_ns % 1000000000 == 0;
+}
+
+// Size and modification time of the log, returns 0 if it can't be read
+static int event_cache_source_info(const char *json_filename, uint64_t *size, int64_t *mtime_ns)
+{
+    struct stat st;
+    if (stat(json_filename, &st) != 0)
+    {
+        return 0;
+    }
+    *size = (uint64_t)st.st_size;
+#if defined(_WIN32)
+    *mtime_ns = (int64_t)st.st_mtime * 1000000000;
+#elif defined(__APPLE__)
+    *mtime_ns = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    *mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return 1;
+}
+
+static char *event_cache_filename(const char *json_filename)
+{
+    char *path = (char *)malloc(strlen(json_filename) + sizeof(EVENT_CACHE_SUFFIX));
+    if (path)
+    {
+        strcpy(path, json_filename);
+        strcat(path, EVENT_CACHE_SUFFIX);
+    }
+    return path;
+}
+
+// Check a cache header against the log and this build, returns 1 if the events can be used
+static int event_cache_header_valid(const EventCacheHeader *header, uint64_t file_size, uint64_t source_size,
+                                    int64_t source_mtime_ns)
+{
+    return memcmp(header->magic, EVENT_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == EVENT_CACHE_VERSION && header->event_size == sizeof(RegisterEvent) &&
+           header->delay_samples == DELAY_SAMPLES && header->source_size == source_size &&
+           header->source_mtime_ns == source_mtime_ns &&
+           file_size == sizeof(EventCacheHeader) + header->event_count * sizeof(RegisterEvent);
+}
+
+// Load the cached pass2 events of a log, returns NULL if there is no valid cache (nothing is printed then)
+RegisterEventList *load_event_cache(const char *json_filename)
+{
+    uint64_t source_size;
+    int64_t source_mtime_ns;
+    char *path = event_cache_filename(json_filename);
+    if (!path || !event_cache_source_info(json_filename, &source_size, &source_mtime_ns))
+    {
+        free(path);
+        return NULL;
+    }
+
+    FILE *fp = fopen(path, "rb");
+    free(path);
+    if (!fp)
+    {
+        return NULL;
+    }
+    EventCacheHeader header;
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (file_size < (long)sizeof(EventCacheHeader) || fread(&header, sizeof(header), 1, fp) != 1 ||
+        !event_cache_header_valid(&header, (uint64_t)file_size, source_size, source_mtime_ns))
+    {
+        fclose(fp);
+        return NULL;
+    }
+    uint64_t source_hash;
+    if (event_cache_mtime_is_coarse(source_mtime_ns) &&
+        (!event_cache_hash_file(json_filename, &source_hash) || source_hash != header.source_hash))
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    size_t events_size = (size_t)header.event_count * sizeof(RegisterEvent);
+#ifdef _WIN32
+    void *mapping = NULL;
+    RegisterEvent *events = (RegisterEvent *)malloc(events_size ? events_size : 1);
+    int ok = events && fread(events, 1, events_size, fp) == events_size;
+    fclose(fp);
+#else
+    // Private writable mapping: pages are shared with the page cache until something writes to them
+    void *mapping = mmap(NULL, (size_t)file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), 0);
+    fclose(fp);
+    if (mapping == MAP_FAILED)
+    {
+        return NULL;
+    }
+    RegisterEvent *events = (RegisterEvent *)((uint8_t *)mapping + sizeof(EventCacheHeader));
+    int ok = 1;
+#endif
+    ok = ok && event_cache_hash(events, events_size) == header.payload_hash;
+
+    RegisterEventList *list = ok ? (RegisterEventList *)calloc(1, sizeof(RegisterEventList)) : NULL;
+    if (!list)
+    {
+#ifdef _WIN32
+        free(events);
+#else
+        munmap(mapping, (size_t)file_size);
+#endif
+        return NULL;
+    }
+    list->events = events;
+    list->count = (size_t)header.event_count;
+    list->capacity = list->count;
+    list->mapping = mapping;
+    list->mapping_size = (size_t)file_size;
+    list->loop.enabled = (uint8_t)(header.loop_flags & 1);
+    list->loop.has_end = (uint8_t)((header.loop_flags >> 1) & 1);
+    list->loop.start_time = header.loop_start_time;
+    list->loop.end_time = header.loop_end_time;
+    list->loop.start_index = (size_t)header.loop_start_index;
+    list->loop.end_index = (size_t)header.loop_end_index;
+    return list;
+}
+
+// Save pass2 events parsed from a log as its sidecar cache (written to a temporary file, then renamed)
+int save_event_cache(const char *json_filename, const RegisterEventList *events)
+{
+    EventCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    if (!event_cache_source_info(json_filename, &header.source_size, &header.source_mtime_ns) ||
+        !event_cache_hash_file(json_filename, &header.source_hash))
+    {
+        return 0;
+    }
+    memcpy(header.magic, EVENT_CACHE_MAGIC, sizeof(header.magic));
+    header.version = EVENT_CACHE_VERSION;
+    header.event_size = sizeof(RegisterEvent);
+    header.delay_samples = DELAY_SAMPLES;
+    header.loop_flags = (uint32_t)events->loop.enabled | (uint32_t)events->loop.has_end << 1;
+    header.event_count = events->count;
+    header.loop_start_time = events->loop.start_time;
+    header.loop_end_time = events->loop.end_time;
+    header.loop_start_index = events->loop.start_index;
+    header.loop_end_index = events->loop.end_index;
+    header.payload_hash = event_cache_hash(events->events, events->count * sizeof(RegisterEvent));
+
+    char *path = event_cache_filename(json_filename);
+    char *temp_path = path ? (char *)malloc(strlen(path) + 5) : NULL;
+    if (!temp_path)
+    {
+        free(path);
+        return 0;
+    }
+    strcpy(temp_path, path);
+    strcat(temp_path, ".tmp");
+
+    FILE *fp = fopen(temp_path, "wb");
+    int ok = fp && fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(events->events, sizeof(RegisterEvent), events->count, fp) == events->count;
+    if (fp && fclose(fp) != 0)
+    {
+        ok = 0;
+    }
+#ifdef _WIN32
+    remove(path); // rename() does not replace an existing file on Windows
+#endif
+    if (ok && rename(temp_path, path) != 0)
+    {
+        ok = 0;
+    }
+    if (!ok)
+    {
+        remove(temp_path);
+        fprintf(stderr, "⚠️  Failed to write event cache %s\n", path);
+    }
+    else
+    {
+        printf("✅ Saved event cache %s\n", path);
+    }
+    free(temp_path);
+    free(path);
+    return ok;
+}
+
+// Load pass2 events from the sidecar cache, or parse the log and (re)write the cache
+RegisterEventList *load_events_json_cached(const char *json_filename)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RegisterEventList *events = load_event_cache(json_filename);
+    if (events)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        printf("✅ Loaded %zu events from the cache of %s (%.2f ms)\n\n", events->count, json_filename,
+               (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0);
+        return events;
+    }
+
+    events = load_events_json(json_filename);
+    if (events)
+    {
+        save_event_cache(json_filename, events);
+        printf("\n");
+    }
+    return events;
+}
+
+#endif // EVENT_CACHE_H
@@ -0,0 +1,133 @@
+#ifndef EVENT_OPTIMIZER_H
+#define EVENT_OPTIMIZER_H
+
+#include "events.h"
+
+// Redundant register write elimination (pass1)
+// A shadow copy of the register file holds the last value written to each register, and writes that
+// restate it are dropped. Each dropped write saves two pass2 events and 2 * DELAY_SAMPLES of spacing.
+// Writes with effects beyond storing a value are always kept: 0x01 (test, LFO reset), 0x08 (key on/off),
+// 0x14 (timer load/reset), 0x18 (restarts the LFO counter) and 0x19 (AMD and PMD share the address).
+// The first write to each register is kept too, since the chip state before the log is unknown.
+// The same holds at a loop start: after a wrap the chip state is the one at the loop end, so the shadow
+// is cleared there.
+// The shadow follows list order, which is the chip's order only while each burst of same-time writes ends
+// (pass2 timing: 2 * DELAY_SAMPLES per write) before the next burst starts. Overlapping bursts interleave
+// on the chip, and an address and a data write on the same sample share the write_data latch, so the
+// register contents are unknown there: every write of overlapping bursts is kept and the shadow is cleared.
+
+// Registers whose writes must never be dropped
+static int register_write_has_side_effect(uint8_t address)
+{
+    switch (address)
+    {
+    case 0x01:
+    case 0x08:
+    case 0x14:
+    case 0x18:
+    case 0x19:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Mark the writes of bursts whose pass2 writes overlap another burst, returns the number marked
+static size_t mark_overlapping_bursts(const RegisterEventList *pass1, uint8_t *overlapping)
+{
+    size_t marked = 0;
+    size_t cluster_start = 0;  // First event of the current run of overlapping bursts
+    int cluster_bursts = 0;
+    uint64_t cluster_end = 0; // Last pass2 sample of the run
+    for (size_t i = 0; i < pass1->count;)
+    {
+        // One burst: the events with the same time
+        size_t end = i + 1;
+        while (end < pass1->count && pass1->events[end].sample_time == pass1->events[i].sample_time)
+        {
+            end++;
+        }
+        uint64_t start_time = pass1->events[i].sample_time;
+        uint64_t end_time = start_time + (uint64_t)(end - i) * 2 * DELAY_SAMPLES - DELAY_SAMPLES;
+        if (cluster_bursts > 0 && start_time <= cluster_end)
+        {
+            cluster_bursts++;
+            cluster_end = end_time > cluster_end ? end_time : cluster_end;
+        }
+        else
+        {
+            if (cluster_bursts > 1)
+            {
+                memset(overlapping + cluster_start, 1, i - cluster_start);
+                marked += i - cluster_start;
+            }
+            cluster_start = i;
+            cluster_bursts = 1;
+            cluster_end = end_time;
+        }
+        i = end;
+    }
+    if (cluster_bursts > 1)
+    {
+        memset(overlapping + cluster_start, 1, pass1->count - cluster_start);
+        marked += pass1->count - cluster_start;
+    }
+    return marked;
+}
+
+// Return a new pass1 list without redundant writes (the input list is not modified)
+RegisterEventList *optimize_redundant_writes(RegisterEventList *pass1)
+{
+    uint8_t shadow[256];
+    uint8_t written[256];
+    memset(written, 0, sizeof(written));
+
+    uint8_t *overlapping = (uint8_t *)calloc(pass1->count ? pass1->count : 1, 1);
+    if (!overlapping)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for write elimination\n");
+        exit(1);
+    }
+    size_t overlapped = mark_overlapping_bursts(pass1, overlapping);
+
+    RegisterEventList *list = create_event_list();
+    list->loop = pass1->loop;
+    int loop_pending = pass1->loop.enabled;
+    for (size_t i = 0; i < pass1->count; i++)
+    {
+        RegisterEvent *event = &pass1->events[i];
+        if (loop_pending && event->sample_time >= pass1->loop.start_time)
+        {
+            memset(written, 0, sizeof(written));
+            loop_pending = 0;
+        }
+        if (overlapping[i])
+        {
+            memset(written, 0, sizeof(written));
+            add_event_with_flag(list, event->sample_time, event->address, event->data, 0);
+            continue;
+        }
+        if (written[event->address] && shadow[event->address] == event->data &&
+            !register_write_has_side_effect(event->address))
+        {
+            continue;
+        }
+        shadow[event->address] = event->data;
+        written[event->address] = 1;
+        add_event_with_flag(list, event->sample_time, event->address, event->data, 0);
+    }
+
+    free(overlapping);
+
+    size_t removed = pass1->count - list->count;
+    printf("Redundant write elimination: removed %zu of %zu register writes (%.1f%%)\n", removed, pass1->count,
+           pass1->count ? removed * 100.0 / pass1->count : 0.0);
+    if (overlapped)
+    {
+        printf("  %zu writes kept in overlapping bursts (pass2 writes interleave or share a sample)\n", overlapped);
+    }
+    printf("\n");
+    return list;
+}
+
+#endif // EVENT_OPTIMIZER_H
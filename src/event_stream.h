@@ -0,0 +1,226 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include "events.h"
+
+// Compact in-memory event stream
+// Each pass1 register write is stored as a zigzag varint time delta (1 byte for deltas up to +-63 samples)
+// followed by the address and data bytes: typically 3-5 bytes instead of two 8-byte pass2 RegisterEvents.
+// The pass2 split (address write, data write DELAY_SAMPLES later, delays accumulated within the same time)
+// is implied and reproduced by the decoder exactly as convert_to_pass2_format does.
+
+// Pass1 events in the compact encoding
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    size_t count;              // Number of pass1 events
+    uint32_t last_time;        // Time of the previously appended pass1 event (delta base)
+    uint32_t last_sample_time; // Latest pass2 event time (for playback duration)
+    uint32_t group_time;       // Pass2 delay accumulation state of the encoder
+    uint32_t group_delay;
+    LoopMarker loop;           // Times only (the decoder locates the loop body, see loop_playback.h)
+} EventStream;
+
+// Sequential decoder state for EventStream, yields pass2 events
+typedef struct
+{
+    size_t pos;                 // Read position in stream data
+    uint32_t time;              // Time of the last decoded pass1 event
+    uint32_t group_time;        // Pass2 delay accumulation (same as convert_to_pass2_format)
+    uint32_t accumulated_delay;
+    uint32_t data_time;         // Time of the pending data write
+    uint8_t data_pending;       // 1 if the data write of the last pass1 event is still to come
+    uint8_t valid;              // 1 if 'current' holds an event
+    RegisterEvent current;      // Next pass2 event
+} EventStreamCursor;
+
+// Create empty event stream
+EventStream *create_event_stream()
+{
+    EventStream *stream = (EventStream *)calloc(1, sizeof(EventStream));
+    if (!stream)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for event stream\n");
+        exit(1);
+    }
+    stream->capacity = 1024;
+    stream->data = (uint8_t *)malloc(stream->capacity);
+    if (!stream->data)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for event stream data\n");
+        free(stream);
+        exit(1);
+    }
+    return stream;
+}
+
+// Free event stream
+void free_event_stream(EventStream *stream)
+{
+    free(stream->data);
+    free(stream);
+}
+
+// Append one pass1 register write
+void event_stream_append(EventStream *stream, uint32_t sample_time, uint8_t address, uint8_t data)
+{
+    // Worst case: 5 varint bytes + address + data
+    if (stream->size + 7 > stream->capacity)
+    {
+        stream->capacity *= 2;
+        uint8_t *new_data = (uint8_t *)realloc(stream->data, stream->capacity);
+        if (!new_data)
+        {
+            fprintf(stderr, "❌ Failed to reallocate memory for event stream\n");
+            exit(1);
+        }
+        stream->data = new_data;
+    }
+
+    // Zigzag encoding keeps out-of-order (negative) deltas small too
+    int32_t delta = (int32_t)(sample_time - stream->last_time);
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    while (zigzag >= 0x80)
+    {
+        stream->data[stream->size++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    stream->data[stream->size++] = (uint8_t)zigzag;
+    stream->data[stream->size++] = address;
+    stream->data[stream->size++] = data;
+    stream->last_time = sample_time;
+    stream->count++;
+
+    // Track the time of the last pass2 write (same accumulation as convert_to_pass2_format)
+    if (stream->count == 1 || sample_time != stream->group_time)
+    {
+        stream->group_delay = 0;
+        stream->group_time = sample_time;
+    }
+    stream->group_delay += DELAY_SAMPLES * 2;
+    uint32_t data_time = sample_time + stream->group_delay - DELAY_SAMPLES;
+    if (data_time > stream->last_sample_time)
+    {
+        stream->last_sample_time = data_time;
+    }
+}
+
+// Encode pass1 event list into a new event stream
+EventStream *encode_event_stream(RegisterEventList *pass1)
+{
+    EventStream *stream = create_event_stream();
+    for (size_t i = 0; i < pass1->count; i++)
+    {
+        event_stream_append(stream, pass1->events[i].sample_time, pass1->events[i].address, pass1->events[i].data);
+    }
+    stream->loop = pass1->loop;
+
+    // Shrink to fit
+    if (stream->size > 0)
+    {
+        uint8_t *data = (uint8_t *)realloc(stream->data, stream->size);
+        if (data)
+        {
+            stream->data = data;
+            stream->capacity = stream->size;
+        }
+    }
+
+    printf("Encoded %zu events into compact stream: %zu bytes (pass2 array: %zu bytes)\n\n",
+           stream->count, stream->size, stream->count * 2 * sizeof(RegisterEvent));
+    return stream;
+}
+
+// Move cursor to the next pass2 event ('valid' is cleared at the end of the stream)
+void event_stream_advance(const EventStream *stream, EventStreamCursor *cursor)
+{
+    if (cursor->data_pending)
+    {
+        // Data register write of the current pass1 event
+        cursor->current.sample_time = cursor->data_time;
+        cursor->current.is_data_write = 1;
+        cursor->data_pending = 0;
+        return;
+    }
+
+    if (cursor->pos >= stream->size)
+    {
+        cursor->valid = 0;
+        return;
+    }
+
+    // Decode next pass1 event
+    uint32_t zigzag = 0;
+    uint32_t shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = stream->data[cursor->pos++];
+        zigzag |= (uint32_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+    uint32_t time = cursor->time + (uint32_t)delta;
+    cursor->time = time;
+
+    // Reset accumulated delay when the time changes
+    if (time != cursor->group_time)
+    {
+        cursor->accumulated_delay = 0;
+        cursor->group_time = time;
+    }
+
+    cursor->current.address = stream->data[cursor->pos++];
+    cursor->current.data = stream->data[cursor->pos++];
+    cursor->current.sample_time = time + cursor->accumulated_delay;
+    cursor->current.is_data_write = 0;
+    cursor->accumulated_delay += DELAY_SAMPLES;
+    cursor->data_time = time + cursor->accumulated_delay;
+    cursor->accumulated_delay += DELAY_SAMPLES;
+    cursor->data_pending = 1;
+    cursor->valid = 1;
+}
+
+// Reset cursor to the first pass2 event
+void event_stream_rewind(const EventStream *stream, EventStreamCursor *cursor)
+{
+    memset(cursor, 0, sizeof(EventStreamCursor));
+    event_stream_advance(stream, cursor);
+}
+
+// Save event stream to JSON file in pass2 format (same output as save_events_json)
+int save_event_stream_json(const char *filename, const EventStream *stream)
+{
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "❌ Failed to open %s for writing\n", filename);
+        return 0;
+    }
+
+    size_t count = stream->count * 2;
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"event_count\": %zu,\n", count);
+    save_loop_marker_json(fp, &stream->loop);
+    fprintf(fp, "  \"events\": [\n");
+
+    EventStreamCursor cursor;
+    size_t i = 0;
+    for (event_stream_rewind(stream, &cursor); cursor.valid; event_stream_advance(stream, &cursor), i++)
+    {
+        fprintf(fp, "    {\"time\": %u, \"addr\": \"0x%02X\", \"data\": \"0x%02X\", \"is_data\": %d}%s\n",
+                cursor.current.sample_time, cursor.current.address, cursor.current.data,
+                cursor.current.is_data_write, i < count - 1 ? "," : "");
+    }
+
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+
+    fclose(fp);
+    printf("✅ Saved %zu events to %s (pass2 format)\n", count, filename);
+    return 1;
+}
+
+#endif // EVENT_STREAM_H
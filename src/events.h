@@ -1,69 +1,244 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
 #include "types.h"
 
-// Initialize register event list
-RegisterEventList *create_event_list()
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// Register write event structure
+// Note: Both address and data are stored in each event for simplicity and clarity in JSON output.
+// For address write events (is_data_write=0), the 'data' field shows what data will be written in the subsequent data event.
+// For data write events (is_data_write=1), the 'address' field shows which register the data is being written to.
+typedef struct
+{
+    uint32_t sample_time;  // Time in samples from start (not delta)
+    uint8_t address;       // YM2151 register address
+    uint8_t data;          // Data to write to the register
+    uint8_t is_data_write; // 0 = address register write, 1 = data register write (for pass2 only)
+} RegisterEvent;
+
+// Loop marker of a log ("loop_start" and optional "loop_end" keys, see json_loader.h)
+typedef struct
+{
+    uint8_t enabled;
+    uint8_t has_end;     // 0 = the loop body runs to the last event
+    uint32_t start_time; // Pass1 time playback wraps back to
+    uint32_t end_time;   // Pass1 time of the first event after the loop body
+    size_t start_index;  // Pass2 lists only: first event of the loop body (set by split_pass1_events)
+    size_t end_index;    // Pass2 lists only: first event after the loop body
+} LoopMarker;
+
+// Dynamic array for register events
+typedef struct
+{
+    RegisterEvent *events;
+    size_t count;
+    size_t capacity;
+    LoopMarker loop;
+    void *mapping;       // Mapped cache file holding 'events' (NULL = events are malloc'd), see event_cache.h
+    size_t mapping_size;
+} RegisterEventList;
+
+// The try_ functions return an error instead of exiting when out of memory (used by the render library,
+// see ym2151_render.c); the functions without the prefix report the error and exit.
+
+// Initialize register event list, returns NULL if out of memory
+RegisterEventList *try_create_event_list()
 {
     RegisterEventList *list = (RegisterEventList *)malloc(sizeof(RegisterEventList));
     if (!list)
     {
-        fprintf(stderr, "❌ Failed to allocate memory for event list\n");
-        exit(1);
+        return NULL;
     }
     list->capacity = 256;
     list->count = 0;
+    memset(&list->loop, 0, sizeof(LoopMarker));
+    list->mapping = NULL;
+    list->mapping_size = 0;
     list->events = (RegisterEvent *)malloc(sizeof(RegisterEvent) * list->capacity);
     if (!list->events)
     {
-        fprintf(stderr, "❌ Failed to allocate memory for events array\n");
         free(list);
+        return NULL;
+    }
+    return list;
+}
+
+// Initialize register event list
+RegisterEventList *create_event_list()
+{
+    RegisterEventList *list = try_create_event_list();
+    if (!list)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for event list\n");
         exit(1);
     }
     return list;
 }
 
-// Add event to list with is_data_write flag
-void add_event_with_flag(RegisterEventList *list, uint32_t sample_time, uint8_t address, uint8_t data, uint8_t is_data_write)
+// Add event to list with is_data_write flag, returns 0 if out of memory (the list is left unchanged)
+int try_add_event_with_flag(RegisterEventList *list, uint32_t sample_time, uint8_t address, uint8_t data,
+                            uint8_t is_data_write)
 {
     if (list->count >= list->capacity)
     {
-        list->capacity *= 2;
-        RegisterEvent *new_events = (RegisterEvent *)realloc(list->events, sizeof(RegisterEvent) * list->capacity);
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        RegisterEvent *new_events = (RegisterEvent *)realloc(list->events, sizeof(RegisterEvent) * capacity);
         if (!new_events)
         {
-            fprintf(stderr, "❌ Failed to reallocate memory for events\n");
-            exit(1);
+            return 0;
         }
         list->events = new_events;
+        list->capacity = capacity;
     }
     list->events[list->count].sample_time = sample_time;
     list->events[list->count].address = address;
     list->events[list->count].data = data;
     list->events[list->count].is_data_write = is_data_write;
     list->count++;
+    return 1;
+}
+
+// Add event to list with is_data_write flag
+void add_event_with_flag(RegisterEventList *list, uint32_t sample_time, uint8_t address, uint8_t data, uint8_t is_data_write)
+{
+    if (!try_add_event_with_flag(list, sample_time, address, data, is_data_write))
+    {
+        fprintf(stderr, "❌ Failed to reallocate memory for events\n");
+        exit(1);
+    }
 }
 
 // Free event list
 void free_event_list(RegisterEventList *list)
 {
-    free(list->events);
+    if (list->mapping)
+    {
+#ifndef _WIN32
+        munmap(list->mapping, list->mapping_size); // Events loaded from a cache file
+#endif
+    }
+    else
+    {
+        free(list->events);
+    }
     free(list);
 }
 
+// Number of events with an earlier time than the event before them (0 = sorted by time)
+size_t count_unsorted_events(const RegisterEventList *list)
+{
+    size_t descents = 0;
+    for (size_t i = 1; i < list->count; i++)
+    {
+        descents += list->events[i].sample_time < list->events[i - 1].sample_time;
+    }
+    return descents;
+}
+
+// Stable LSD radix sort of the events by time (8-bit digits, digits shared by all events are skipped)
+// Logs merged from several captures can be out of order; events with the same time keep their order.
+// Does nothing if the events are already sorted (one comparison per event), returns 1 if it sorted them
+// and -1 if out of memory (the events are left unchanged)
+int try_sort_events_by_time(RegisterEventList *list)
+{
+    size_t descents = count_unsorted_events(list);
+    if (descents == 0)
+    {
+        return 0;
+    }
+
+    size_t histogram[4][256];
+    memset(histogram, 0, sizeof(histogram));
+    for (size_t i = 0; i < list->count; i++)
+    {
+        uint32_t time = list->events[i].sample_time;
+        histogram[0][time & 0xFF]++;
+        histogram[1][(time >> 8) & 0xFF]++;
+        histogram[2][(time >> 16) & 0xFF]++;
+        histogram[3][time >> 24]++;
+    }
+
+    RegisterEvent *buffer = (RegisterEvent *)malloc(sizeof(RegisterEvent) * list->count);
+    if (!buffer)
+    {
+        return -1;
+    }
+    RegisterEvent *source = list->events;
+    RegisterEvent *target = buffer;
+    for (int digit = 0; digit < 4; digit++)
+    {
+        int shift = digit * 8;
+        if (histogram[digit][(source[0].sample_time >> shift) & 0xFF] == list->count)
+        {
+            continue; // Same digit everywhere: the pass would not move anything
+        }
+        size_t offsets[256];
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++)
+        {
+            offsets[bucket] = offset;
+            offset += histogram[digit][bucket];
+        }
+        for (size_t i = 0; i < list->count; i++)
+        {
+            target[offsets[(source[i].sample_time >> shift) & 0xFF]++] = source[i];
+        }
+        RegisterEvent *swap = source;
+        source = target;
+        target = swap;
+    }
+
+    // Keep whichever buffer holds the sorted events
+    free(target);
+    list->events = source;
+    list->capacity = list->count;
+    fprintf(stderr, "⚠️  %zu events were out of time order, sorted by time\n", descents);
+    return 1;
+}
+
+// Sort the events by time (see try_sort_events_by_time), returns 1 if it sorted them
+int sort_events_by_time(RegisterEventList *list)
+{
+    int sorted = try_sort_events_by_time(list);
+    if (sorted < 0)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for sorting events\n");
+        exit(1);
+    }
+    return sorted;
+}
+
+// Write the loop marker keys (nothing if the log has no loop)
+void save_loop_marker_json(FILE *fp, const LoopMarker *loop)
+{
+    if (loop->enabled)
+    {
+        fprintf(fp, "  \"loop_start\": %u,\n", loop->start_time);
+    }
+    if (loop->enabled && loop->has_end)
+    {
+        fprintf(fp, "  \"loop_end\": %u,\n", loop->end_time);
+    }
+}
+
 // Calculate samples for a duration at internal sample rate
 uint32_t duration_to_samples(double duration_seconds)
 {
     return (uint32_t)(duration_seconds * INTERNAL_SAMPLE_RATE);
 }
 
-// Convert pass1 format events to pass2 format (add register write delays and split addr/data writes)
-// This function takes simple register write events and converts them into the format needed by the YM2151,
-// which requires separate address and data register writes with timing delays between them.
-RegisterEventList *convert_to_pass2_format(RegisterEventList *pass1)
+// Split pass1 register writes into pass2 address/data writes with delays (no console output)
+// Returns NULL if out of memory
+RegisterEventList *try_split_pass1_events(RegisterEventList *pass1)
 {
-    RegisterEventList *list = create_event_list();
-
-    printf("Converting to pass2 format: Splitting register writes and adding delays\n");
-    printf("  Delay per register write: %d samples\n", DELAY_SAMPLES);
+    RegisterEventList *list = try_create_event_list();
+    if (!list)
+    {
+        return NULL;
+    }
 
     uint32_t accumulated_delay = 0;
     uint32_t last_time = 0;
@@ -85,19 +260,82 @@ RegisterEventList *convert_to_pass2_format(RegisterEventList *pass1)
 
         // 1. Address register write at time T
         uint32_t addr_time = event->sample_time + accumulated_delay;
-        add_event_with_flag(list, addr_time, event->address, event->data, 0); // is_data_write = 0
         accumulated_delay += DELAY_SAMPLES;
 
         // 2. Data register write at time T + DELAY_SAMPLES
         uint32_t data_time = event->sample_time + accumulated_delay;
-        add_event_with_flag(list, data_time, event->address, event->data, 1); // is_data_write = 1
         accumulated_delay += DELAY_SAMPLES;
+
+        if (!try_add_event_with_flag(list, addr_time, event->address, event->data, 0) || // is_data_write = 0
+            !try_add_event_with_flag(list, data_time, event->address, event->data, 1))   // is_data_write = 1
+        {
+            free_event_list(list);
+            return NULL;
+        }
     }
 
+    // Pass1 event i became pass2 events 2i and 2i+1
+    list->loop = pass1->loop;
+    if (pass1->loop.enabled)
+    {
+        list->loop.start_index = list->count;
+        list->loop.end_index = list->count;
+        for (size_t i = pass1->count; i-- > 0;)
+        {
+            if (pass1->events[i].sample_time >= pass1->loop.start_time)
+            {
+                list->loop.start_index = 2 * i;
+            }
+            if (pass1->loop.has_end && pass1->events[i].sample_time >= pass1->loop.end_time)
+            {
+                list->loop.end_index = 2 * i;
+            }
+        }
+    }
+    return list;
+}
+
+// Split pass1 register writes into pass2 address/data writes with delays (no console output)
+RegisterEventList *split_pass1_events(RegisterEventList *pass1)
+{
+    RegisterEventList *list = try_split_pass1_events(pass1);
+    if (!list)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for events\n");
+        exit(1);
+    }
+    return list;
+}
+
+// Convert pass1 format events to pass2 format (add register write delays and split addr/data writes)
+// This function takes simple register write events and converts them into the format needed by the YM2151,
+// which requires separate address and data register writes with timing delays between them.
+RegisterEventList *convert_to_pass2_format(RegisterEventList *pass1)
+{
+    printf("Converting to pass2 format: Splitting register writes and adding delays\n");
+    printf("  Delay per register write: %d samples\n", DELAY_SAMPLES);
+
+    RegisterEventList *list = split_pass1_events(pass1);
+
     printf("  Conversion complete: %zu events (split from %zu pass1 events)\n\n", list->count, pass1->count);
     return list;
 }
 
+// Calculate total playback duration from the time of the last event
+double playback_duration_from_last_time(uint32_t last_event_time)
+{
+    // Add 1 second after last event
+    uint32_t total_samples = last_event_time + INTERNAL_SAMPLE_RATE;
+    double duration = (double)total_samples / INTERNAL_SAMPLE_RATE;
+
+    printf("Playback duration calculation:\n");
+    printf("  Last event at: %u samples (%.3f seconds)\n",
+           last_event_time, (double)last_event_time / INTERNAL_SAMPLE_RATE);
+    printf("  Total duration: %.3f seconds (%u samples)\n\n", duration, total_samples);
+
+    return duration;
+}
+
 // Calculate total playback duration from events
 double calculate_playback_duration(RegisterEventList *events)
 {
@@ -114,14 +352,7 @@ double calculate_playback_duration(RegisterEventList *events)
         }
     }
 
-    // Add 1 second after last event
-    uint32_t total_samples = last_event_time + INTERNAL_SAMPLE_RATE;
-    double duration = (double)total_samples / INTERNAL_SAMPLE_RATE;
-
-    printf("Playback duration calculation:\n");
-    printf("  Last event at: %u samples (%.3f seconds)\n",
-           last_event_time, (double)last_event_time / INTERNAL_SAMPLE_RATE);
-    printf("  Total duration: %.3f seconds (%u samples)\n\n", duration, total_samples);
-
-    return duration;
+    return playback_duration_from_last_time(last_event_time);
 }
+
+#endif // EVENTS_H
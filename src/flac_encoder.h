@@ -0,0 +1,872 @@
+#ifndef FLAC_ENCODER_H
+#define FLAC_ENCODER_H
+
+#include "render_queue.h"
+#include "sample_convert.h"
+
+// Streaming FLAC encoder
+// Rendered audio is handed over block by block as it is produced (flac_encoder_write, in the integer
+// output formats of sample_convert.h) and encoded on the encoder thread, which is fed through a
+// RenderQueue, so encoding overlaps with emulation. Each FLAC frame holds FLAC_BLOCK_FRAMES stereo
+// frames. Per frame the encoder picks the stereo decorrelation (left/right, left/side, side/right or
+// mid/side) with the smallest estimated size, and per subframe the smallest of constant, fixed
+// predictor (order 0-4), LPC (order 1-FLAC_MAX_LPC_ORDER) and verbatim. Residuals use partitioned Rice
+// coding; low bits that are zero in a whole subframe (s24 renders carry 16-bit values) are coded as
+// wasted bits. STREAMINFO is patched with the totals when the encoder is closed. The MD5 signature is
+// left at zero, which means "not computed" to decoders.
+
+#define FLAC_BLOCK_FRAMES 4096     // Frames per FLAC frame (a standard block size)
+#define FLAC_MAX_FIXED_ORDER 4
+#define FLAC_MAX_LPC_ORDER 12
+#define FLAC_LPC_PRECISION 14      // Bits per quantized LPC coefficient
+#define FLAC_MAX_PARTITION_ORDER 8 // Rice partitions: up to 256 per subframe
+#define FLAC_STREAMINFO_OFFSET 8   // "fLaC" + metadata block header
+
+typedef struct
+{
+    uint8_t *data;
+    size_t pos;   // Bytes completed
+    uint64_t acc; // Pending bits (low 'bits' bits)
+    int bits;
+} FlacBitWriter;
+
+typedef struct
+{
+    FILE *fp;
+    SampleFormat format;      // Layout of the blocks passed to flac_encoder_write (s16, s16clip or s24)
+    uint32_t bits_per_sample;
+    uint32_t sample_rate;
+    RenderQueue queue;        // Blocks of FLAC_BLOCK_FRAMES interleaved stereo int32 frames
+    int32_t *pending;         // Queue block being filled by flac_encoder_write (NULL = none)
+    size_t pending_frames;
+    ma_thread thread;         // Encoder thread: encodes and writes the queued blocks
+    int thread_started;
+
+    // Encoder thread state
+    int32_t *channels[4];     // Left, right, side (left - right), mid ((left + right) >> 1) of one block
+    int32_t *shifted;         // Subframe samples without their wasted low bits
+    int32_t *residual;
+    int32_t *best_residual;
+    double *windowed;         // LPC analysis input
+    uint8_t *frame;           // Encoded frame
+    uint64_t frame_number;
+    uint64_t total_frames;    // Sample frames encoded
+    uint32_t min_frame_bytes;
+    uint32_t max_frame_bytes;
+    uint64_t bytes_written;
+    int write_failed;
+    double encode_ms;         // Busy time of the encoder thread
+} FlacEncoder;
+
+static uint8_t flac_crc8_table[256];
+static uint16_t flac_crc16_table[256];
+
+static void flac_init_crc_tables(void)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        uint8_t crc8 = (uint8_t)i;
+        uint16_t crc16 = (uint16_t)(i << 8);
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc8 = (uint8_t)(crc8 & 0x80 ? (crc8 << 1) ^ 0x07 : crc8 << 1);
+            crc16 = (uint16_t)(crc16 & 0x8000 ? (crc16 << 1) ^ 0x8005 : crc16 << 1);
+        }
+        flac_crc8_table[i] = crc8;
+        flac_crc16_table[i] = crc16;
+    }
+}
+
+static double flac_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Append the low 'bits' bits of value (bits <= 32), most significant first
+static void flac_put_bits(FlacBitWriter *writer, uint32_t value, int bits)
+{
+    if (bits == 0)
+    {
+        return;
+    }
+    writer->acc = (writer->acc << bits) | (value & (uint32_t)(0xFFFFFFFFu >> (32 - bits)));
+    writer->bits += bits;
+    while (writer->bits >= 8)
+    {
+        writer->bits -= 8;
+        writer->data[writer->pos++] = (uint8_t)(writer->acc >> writer->bits);
+    }
+}
+
+static void flac_align(FlacBitWriter *writer)
+{
+    if (writer->bits)
+    {
+        flac_put_bits(writer, 0, 8 - writer->bits);
+    }
+}
+
+// Frame number in the UTF-8 like coding of frame headers
+static void flac_put_utf8(FlacBitWriter *writer, uint64_t value)
+{
+    if (value < 0x80)
+    {
+        flac_put_bits(writer, (uint32_t)value, 8);
+        return;
+    }
+    int bytes = 2;
+    while (bytes < 7 && value >= (1ULL << (5 * bytes + 1)))
+    {
+        bytes++;
+    }
+    int shift = 6 * (bytes - 1);
+    flac_put_bits(writer, ((0xFF00u >> bytes) & 0xFF) | (uint32_t)(value >> shift), 8);
+    for (shift -= 6; shift >= 0; shift -= 6)
+    {
+        flac_put_bits(writer, 0x80 | (uint32_t)((value >> shift) & 0x3F), 8);
+    }
+}
+
+// Rice code of a folded residual: quotient in unary (zeros ended by a one), then k low bits
+static void flac_put_rice(FlacBitWriter *writer, uint32_t folded, int k)
+{
+    uint32_t quotient = folded >> k;
+    uint32_t low = folded & (uint32_t)((1ULL << k) - 1);
+    while (quotient >= 32)
+    {
+        flac_put_bits(writer, 0, 32);
+        quotient -= 32;
+    }
+    if (quotient + 1 + k <= 32)
+    {
+        flac_put_bits(writer, (uint32_t)(1ULL << k) | low, (int)quotient + 1 + k);
+    }
+    else
+    {
+        flac_put_bits(writer, 1, (int)quotient + 1);
+        flac_put_bits(writer, low, k);
+    }
+}
+
+static uint32_t flac_fold(int32_t residual)
+{
+    return ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+}
+
+// Rice parameter with the smallest size estimate count * (k + 1) + (sum >> k) for a partition whose
+// folded residuals add up to sum (an upper bound of the coded size)
+static int flac_rice_parameter(uint64_t sum, uint32_t count, uint64_t *bits)
+{
+    int guess = 0;
+    uint64_t mean = count ? sum / count : 0;
+    while (guess < 30 && (2ULL << guess) <= mean)
+    {
+        guess++;
+    }
+    int best = guess;
+    *bits = UINT64_MAX;
+    for (int k = guess > 0 ? guess - 1 : 0; k <= guess + 1 && k <= 30; k++)
+    {
+        uint64_t size = (uint64_t)count * (k + 1) + (sum >> k);
+        if (size < *bits)
+        {
+            *bits = size;
+            best = k;
+        }
+    }
+    return best;
+}
+
+// Choose the partition order and Rice parameters of a residual (the first 'order' entries are warm-up
+// samples and not coded), returns the size estimate in bits including the residual header
+static uint64_t flac_plan_residual(const int32_t *residual, uint32_t n, int order, int *partition_order, int *params)
+{
+    int max_order = 0;
+    while (max_order < FLAC_MAX_PARTITION_ORDER && n % (2u << max_order) == 0 && (n >> (max_order + 1)) > (uint32_t)order)
+    {
+        max_order++;
+    }
+
+    // Folded residual sums of the finest partitions, merged pairwise for each coarser order
+    uint64_t sums[1 << FLAC_MAX_PARTITION_ORDER];
+    uint32_t size = n >> max_order;
+    for (uint32_t p = 0; p < (1u << max_order); p++)
+    {
+        uint64_t sum = 0;
+        for (uint32_t i = p == 0 ? (uint32_t)order : p * size; i < (p + 1) * size; i++)
+        {
+            sum += flac_fold(residual[i]);
+        }
+        sums[p] = sum;
+    }
+
+    uint64_t best_bits = UINT64_MAX;
+    int candidate[1 << FLAC_MAX_PARTITION_ORDER];
+    for (int po = max_order; po >= 0; po--)
+    {
+        uint32_t partitions = 1u << po;
+        uint32_t partition_size = n >> po;
+        uint64_t bits = 6; // Coding method and partition order
+        int wide = 0;
+        for (uint32_t p = 0; p < partitions; p++)
+        {
+            uint64_t partition_bits;
+            candidate[p] = flac_rice_parameter(sums[p], partition_size - (p == 0 ? order : 0), &partition_bits);
+            bits += partition_bits;
+            wide |= candidate[p] > 14;
+        }
+        bits += (uint64_t)partitions * (wide ? 5 : 4);
+        if (bits < best_bits)
+        {
+            best_bits = bits;
+            *partition_order = po;
+            memcpy(params, candidate, partitions * sizeof(int));
+        }
+        for (uint32_t p = 0; p < partitions / 2; p++)
+        {
+            sums[p] = sums[p * 2] + sums[p * 2 + 1];
+        }
+    }
+    return best_bits;
+}
+
+static void flac_write_residual(FlacBitWriter *writer, const int32_t *residual, uint32_t n, int order,
+                                int partition_order, const int *params)
+{
+    uint32_t partitions = 1u << partition_order;
+    int wide = 0;
+    for (uint32_t p = 0; p < partitions; p++)
+    {
+        wide |= params[p] > 14;
+    }
+    flac_put_bits(writer, (uint32_t)wide, 2); // Rice with 4-bit or 5-bit parameters
+    flac_put_bits(writer, (uint32_t)partition_order, 4);
+    uint32_t i = (uint32_t)order;
+    for (uint32_t p = 0; p < partitions; p++)
+    {
+        flac_put_bits(writer, (uint32_t)params[p], wide ? 5 : 4);
+        for (uint32_t end = (p + 1) * (n >> partition_order); i < end; i++)
+        {
+            flac_put_rice(writer, flac_fold(residual[i]), params[p]);
+        }
+    }
+}
+
+// Residual of the fixed predictor of the given order (residual[0..order) = warm-up samples)
+static void flac_fixed_residual(const int32_t *x, uint32_t n, int order, int32_t *residual)
+{
+    memcpy(residual, x, order * sizeof(int32_t));
+    for (uint32_t i = (uint32_t)order; i < n; i++)
+    {
+        switch (order)
+        {
+        case 0:
+            residual[i] = x[i];
+            break;
+        case 1:
+            residual[i] = x[i] - x[i - 1];
+            break;
+        case 2:
+            residual[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+            break;
+        case 3:
+            residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+            break;
+        default:
+            residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+            break;
+        }
+    }
+}
+
+// Fixed predictor order with the smallest residual, returns a size estimate in bits
+static uint64_t flac_fixed_estimate(const int32_t *x, uint32_t n, int *best_order)
+{
+    uint64_t sums[FLAC_MAX_FIXED_ORDER + 1] = {0};
+    for (uint32_t i = FLAC_MAX_FIXED_ORDER; i < n; i++)
+    {
+        int32_t e0 = x[i];
+        int32_t e1 = e0 - x[i - 1];
+        int32_t e2 = e1 - (x[i - 1] - x[i - 2]);
+        int32_t e3 = e2 - (x[i - 1] - 2 * x[i - 2] + x[i - 3]);
+        int32_t e4 = e3 - (x[i - 1] - 3 * x[i - 2] + 3 * x[i - 3] - x[i - 4]);
+        sums[0] += flac_fold(e0);
+        sums[1] += flac_fold(e1);
+        sums[2] += flac_fold(e2);
+        sums[3] += flac_fold(e3);
+        sums[4] += flac_fold(e4);
+    }
+    int order = 0;
+    for (int i = 1; i <= FLAC_MAX_FIXED_ORDER; i++)
+    {
+        order = sums[i] < sums[order] ? i : order;
+    }
+    if ((uint32_t)order >= n)
+    {
+        order = 0;
+    }
+    *best_order = order;
+    uint64_t bits;
+    flac_rice_parameter(sums[order], n > FLAC_MAX_FIXED_ORDER ? n - FLAC_MAX_FIXED_ORDER : 1, &bits);
+    return bits;
+}
+
+// LPC of the best estimated order from the windowed autocorrelation (Levinson-Durbin), quantized to
+// FLAC_LPC_PRECISION bits; returns the order, or 0 if no usable predictor was found
+static int flac_compute_lpc(FlacEncoder *enc, const int32_t *x, uint32_t n, uint32_t bps, int32_t *qlp, int *shift)
+{
+    // Welch window
+    double *windowed = enc->windowed;
+    double half = (n + 1) / 2.0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        double t = (i - (n - 1) / 2.0) / half;
+        windowed[i] = x[i] * (1.0 - t * t);
+    }
+    double autoc[FLAC_MAX_LPC_ORDER + 1];
+    for (int lag = 0; lag <= FLAC_MAX_LPC_ORDER; lag++)
+    {
+        double sum = 0.0;
+        for (uint32_t i = (uint32_t)lag; i < n; i++)
+        {
+            sum += windowed[i] * windowed[i - lag];
+        }
+        autoc[lag] = sum;
+    }
+    if (autoc[0] <= 0.0)
+    {
+        return 0;
+    }
+
+    // Levinson-Durbin recursion: lpc[p - 1] predicts x[i] from x[i - 1] .. x[i - p]
+    double lpc[FLAC_MAX_LPC_ORDER][FLAC_MAX_LPC_ORDER];
+    double a[FLAC_MAX_LPC_ORDER] = {0};
+    double error = autoc[0];
+    int best_order = 0;
+    double best_bits = 0.0;
+    for (int i = 0; i < FLAC_MAX_LPC_ORDER; i++)
+    {
+        double r = -autoc[i + 1];
+        for (int j = 0; j < i; j++)
+        {
+            r -= a[j] * autoc[i - j];
+        }
+        r /= error;
+        a[i] = r;
+        int j = 0;
+        for (; j < i / 2; j++)
+        {
+            double tmp = a[j];
+            a[j] += r * a[i - 1 - j];
+            a[i - 1 - j] += r * tmp;
+        }
+        if (i & 1)
+        {
+            a[j] += a[j] * r;
+        }
+        error *= 1.0 - r * r;
+        for (j = 0; j <= i; j++)
+        {
+            lpc[i][j] = -a[j];
+        }
+
+        // Expected size: coefficients plus residual bits from the prediction error
+        double per_sample = error > 0.0 ? 0.5 * log2(0.5 * error / n) : 0.0;
+        double bits = (i + 1) * (double)(bps + FLAC_LPC_PRECISION) + (n - i - 1) * (per_sample > 0.0 ? per_sample : 0.0);
+        if (best_order == 0 || bits < best_bits)
+        {
+            best_order = i + 1;
+            best_bits = bits;
+        }
+        if (error <= 0.0)
+        {
+            break;
+        }
+    }
+
+    // Quantize with error feedback so the rounding errors don't add up
+    const double *coefs = lpc[best_order - 1];
+    double cmax = 0.0;
+    for (int i = 0; i < best_order; i++)
+    {
+        cmax = fabs(coefs[i]) > cmax ? fabs(coefs[i]) : cmax;
+    }
+    if (cmax <= 0.0)
+    {
+        return 0;
+    }
+    int exponent;
+    frexp(cmax, &exponent);
+    *shift = FLAC_LPC_PRECISION - 1 - exponent;
+    if (*shift < 0)
+    {
+        return 0;
+    }
+    *shift = *shift > 15 ? 15 : *shift;
+    const int32_t qmax = (1 << (FLAC_LPC_PRECISION - 1)) - 1;
+    double carry = 0.0;
+    for (int i = 0; i < best_order; i++)
+    {
+        carry += coefs[i] * (1 << *shift);
+        long q = lround(carry);
+        q = q > qmax ? qmax : q < -qmax - 1 ? -qmax - 1 : q;
+        carry -= q;
+        qlp[i] = (int32_t)q;
+    }
+    return best_order;
+}
+
+// Residual of a quantized LPC, returns 0 if a residual does not fit the Rice coder
+static int flac_lpc_residual(const int32_t *x, uint32_t n, const int32_t *qlp, int order, int shift, int32_t *residual)
+{
+    memcpy(residual, x, order * sizeof(int32_t));
+    for (uint32_t i = (uint32_t)order; i < n; i++)
+    {
+        int64_t prediction = 0;
+        for (int j = 0; j < order; j++)
+        {
+            prediction += (int64_t)qlp[j] * x[i - 1 - j];
+        }
+        int64_t r = x[i] - (prediction >> shift);
+        if (r > (1 << 30) || r < -(1 << 30))
+        {
+            return 0;
+        }
+        residual[i] = (int32_t)r;
+    }
+    return 1;
+}
+
+// Encode one channel of a block with bps bits per sample (one more for a side channel)
+static void flac_write_subframe(FlacEncoder *enc, FlacBitWriter *writer, const int32_t *samples, uint32_t n,
+                                uint32_t bps)
+{
+    int constant = 1;
+    uint32_t ored = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        constant &= samples[i] == samples[0];
+        ored |= (uint32_t)samples[i];
+    }
+    if (constant)
+    {
+        flac_put_bits(writer, 0x00, 8);
+        flac_put_bits(writer, (uint32_t)samples[0], (int)bps);
+        return;
+    }
+
+    // Low bits that are zero in every sample are not coded
+    int wasted = 0;
+    const int32_t *x = samples;
+    while (!(ored & 1))
+    {
+        ored >>= 1;
+        wasted++;
+    }
+    if (wasted)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            enc->shifted[i] = samples[i] >> wasted;
+        }
+        x = enc->shifted;
+        bps -= (uint32_t)wasted;
+    }
+
+    // Verbatim unless a predictor is smaller (estimates are upper bounds of the coded size)
+    enum { VERBATIM, FIXED, LPC } kind = VERBATIM;
+    uint64_t best_bits = (uint64_t)n * bps;
+    int order = 0;
+    int partition_order = 0;
+    int params[1 << FLAC_MAX_PARTITION_ORDER];
+    int candidate_partition_order;
+    int candidate_params[1 << FLAC_MAX_PARTITION_ORDER];
+    int32_t qlp[FLAC_MAX_LPC_ORDER];
+    int shift = 0;
+
+    int fixed_order;
+    flac_fixed_estimate(x, n, &fixed_order);
+    flac_fixed_residual(x, n, fixed_order, enc->residual);
+    uint64_t bits = (uint64_t)fixed_order * bps +
+                    flac_plan_residual(enc->residual, n, fixed_order, &candidate_partition_order, candidate_params);
+    if (bits < best_bits)
+    {
+        kind = FIXED;
+        best_bits = bits;
+        order = fixed_order;
+        partition_order = candidate_partition_order;
+        memcpy(params, candidate_params, sizeof(params));
+        int32_t *swap = enc->best_residual;
+        enc->best_residual = enc->residual;
+        enc->residual = swap;
+    }
+
+    int32_t candidate_qlp[FLAC_MAX_LPC_ORDER];
+    int candidate_shift;
+    int lpc_order = n > 4 * FLAC_MAX_LPC_ORDER ? flac_compute_lpc(enc, x, n, bps, candidate_qlp, &candidate_shift) : 0;
+    if (lpc_order && flac_lpc_residual(x, n, candidate_qlp, lpc_order, candidate_shift, enc->residual))
+    {
+        bits = (uint64_t)lpc_order * (bps + FLAC_LPC_PRECISION) + 9 +
+               flac_plan_residual(enc->residual, n, lpc_order, &candidate_partition_order, candidate_params);
+        if (bits < best_bits)
+        {
+            kind = LPC;
+            order = lpc_order;
+            partition_order = candidate_partition_order;
+            memcpy(params, candidate_params, sizeof(params));
+            memcpy(qlp, candidate_qlp, sizeof(qlp));
+            shift = candidate_shift;
+            int32_t *swap = enc->best_residual;
+            enc->best_residual = enc->residual;
+            enc->residual = swap;
+        }
+    }
+
+    // Subframe header: zero bit, type, wasted bits flag (then the wasted bit count - 1 in unary)
+    uint32_t type = kind == VERBATIM ? 0x01 : kind == FIXED ? 0x08 | (uint32_t)order : 0x20 | (uint32_t)(order - 1);
+    flac_put_bits(writer, type << 1 | (wasted ? 1 : 0), 8);
+    if (wasted)
+    {
+        flac_put_bits(writer, 1, wasted);
+    }
+    if (kind == VERBATIM)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            flac_put_bits(writer, (uint32_t)x[i], (int)bps);
+        }
+        return;
+    }
+    for (int i = 0; i < order; i++)
+    {
+        flac_put_bits(writer, (uint32_t)x[i], (int)bps);
+    }
+    if (kind == LPC)
+    {
+        flac_put_bits(writer, FLAC_LPC_PRECISION - 1, 4);
+        flac_put_bits(writer, (uint32_t)shift, 5);
+        for (int i = 0; i < order; i++)
+        {
+            flac_put_bits(writer, (uint32_t)qlp[i], FLAC_LPC_PRECISION);
+        }
+    }
+    flac_write_residual(writer, enc->best_residual, n, order, partition_order, params);
+}
+
+// Sample rate code of a frame header (extra header bits in *extra_bits, 0 = rate taken from STREAMINFO)
+static uint32_t flac_sample_rate_code(uint32_t rate, int *extra_bits, uint32_t *extra)
+{
+    static const uint32_t rates[] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+    *extra_bits = 0;
+    for (uint32_t code = 1; code < sizeof(rates) / sizeof(rates[0]); code++)
+    {
+        if (rates[code] == rate)
+        {
+            return code;
+        }
+    }
+    if (rate % 1000 == 0 && rate / 1000 <= 255)
+    {
+        *extra_bits = 8;
+        *extra = rate / 1000;
+        return 12;
+    }
+    if (rate <= 65535)
+    {
+        *extra_bits = 16;
+        *extra = rate;
+        return 13;
+    }
+    if (rate % 10 == 0 && rate / 10 <= 65535)
+    {
+        *extra_bits = 16;
+        *extra = rate / 10;
+        return 14;
+    }
+    return 0;
+}
+
+// Encode and write one FLAC frame of n interleaved stereo frames (encoder thread)
+static void flac_encode_block(FlacEncoder *enc, const int32_t *interleaved, uint32_t n)
+{
+    int32_t *left = enc->channels[0];
+    int32_t *right = enc->channels[1];
+    int32_t *side = enc->channels[2];
+    int32_t *mid = enc->channels[3];
+    for (uint32_t i = 0; i < n; i++)
+    {
+        left[i] = interleaved[i * 2];
+        right[i] = interleaved[i * 2 + 1];
+        side[i] = left[i] - right[i];
+        mid[i] = (left[i] + right[i]) >> 1;
+    }
+
+    // Stereo decorrelation with the smallest fixed predictor estimate (capped at the verbatim size)
+    uint64_t estimate[4];
+    for (int c = 0; c < 4; c++)
+    {
+        int order;
+        uint64_t verbatim = (uint64_t)n * (enc->bits_per_sample + (c == 2));
+        estimate[c] = flac_fixed_estimate(enc->channels[c], n, &order);
+        estimate[c] = estimate[c] < verbatim ? estimate[c] : verbatim;
+    }
+    static const int pairs[4][2] = {{0, 1}, {0, 2}, {2, 1}, {3, 2}}; // Independent, left/side, side/right, mid/side
+    static const uint32_t assignments[4] = {0x1, 0x8, 0x9, 0xA};
+    int mode = 0;
+    for (int m = 1; m < 4; m++)
+    {
+        if (estimate[pairs[m][0]] + estimate[pairs[m][1]] < estimate[pairs[mode][0]] + estimate[pairs[mode][1]])
+        {
+            mode = m;
+        }
+    }
+
+    FlacBitWriter writer = {enc->frame, 0, 0, 0};
+    flac_put_bits(&writer, 0xFFF8, 16); // Sync code, fixed block size
+    uint32_t block_code = n == FLAC_BLOCK_FRAMES ? 12 : n <= 256 ? 6 : 7;
+    int rate_bits;
+    uint32_t rate_extra = 0;
+    uint32_t rate_code = flac_sample_rate_code(enc->sample_rate, &rate_bits, &rate_extra);
+    flac_put_bits(&writer, block_code << 4 | rate_code, 8);
+    flac_put_bits(&writer, assignments[mode] << 4 | (enc->bits_per_sample == 24 ? 6 : 4) << 1, 8);
+    flac_put_utf8(&writer, enc->frame_number);
+    if (block_code != 12)
+    {
+        flac_put_bits(&writer, n - 1, block_code == 6 ? 8 : 16);
+    }
+    flac_put_bits(&writer, rate_extra, rate_bits);
+    uint8_t crc8 = 0;
+    for (size_t i = 0; i < writer.pos; i++)
+    {
+        crc8 = flac_crc8_table[crc8 ^ writer.data[i]];
+    }
+    flac_put_bits(&writer, crc8, 8);
+
+    for (int c = 0; c < 2; c++)
+    {
+        int channel = pairs[mode][c];
+        flac_write_subframe(enc, &writer, enc->channels[channel], n, enc->bits_per_sample + (channel == 2));
+    }
+    flac_align(&writer);
+    uint16_t crc16 = 0;
+    for (size_t i = 0; i < writer.pos; i++)
+    {
+        crc16 = (uint16_t)(crc16 << 8) ^ flac_crc16_table[(crc16 >> 8) ^ writer.data[i]];
+    }
+    flac_put_bits(&writer, crc16, 16);
+
+    if (!enc->write_failed && fwrite(writer.data, 1, writer.pos, enc->fp) != writer.pos)
+    {
+        enc->write_failed = 1;
+    }
+    uint32_t frame_bytes = (uint32_t)writer.pos;
+    enc->min_frame_bytes = enc->frame_number == 0 || frame_bytes < enc->min_frame_bytes ? frame_bytes : enc->min_frame_bytes;
+    enc->max_frame_bytes = frame_bytes > enc->max_frame_bytes ? frame_bytes : enc->max_frame_bytes;
+    enc->bytes_written += frame_bytes;
+    enc->total_frames += n;
+    enc->frame_number++;
+}
+
+static ma_thread_result MA_THREADCALL flac_encoder_thread(void *user_data)
+{
+    FlacEncoder *enc = (FlacEncoder *)user_data;
+    size_t frames;
+    const int32_t *block;
+    while ((block = (const int32_t *)render_queue_begin_read(&enc->queue, &frames)) != NULL)
+    {
+        double start = flac_now_ms();
+        flac_encode_block(enc, block, (uint32_t)frames);
+        enc->encode_ms += flac_now_ms() - start;
+        render_queue_end_read(&enc->queue);
+    }
+    return (ma_thread_result)0;
+}
+
+// "fLaC" marker and STREAMINFO (written with zero totals at the start, patched by flac_encoder_close)
+static int flac_write_stream_header(FlacEncoder *enc)
+{
+    uint8_t header[FLAC_STREAMINFO_OFFSET + 34];
+    FlacBitWriter writer = {header, 0, 0, 0};
+    uint32_t block_size = FLAC_BLOCK_FRAMES;
+    if (enc->frame_number <= 1 && enc->total_frames < FLAC_BLOCK_FRAMES)
+    {
+        block_size = enc->total_frames > 16 ? (uint32_t)enc->total_frames : 16; // Single short frame
+    }
+    flac_put_bits(&writer, 0x664C6143, 32); // "fLaC"
+    flac_put_bits(&writer, 0x80, 8);        // Last metadata block, type STREAMINFO
+    flac_put_bits(&writer, 34, 24);
+    flac_put_bits(&writer, block_size, 16);
+    flac_put_bits(&writer, block_size, 16);
+    flac_put_bits(&writer, enc->min_frame_bytes, 24);
+    flac_put_bits(&writer, enc->max_frame_bytes, 24);
+    flac_put_bits(&writer, enc->sample_rate, 20);
+    flac_put_bits(&writer, 2 - 1, 3);
+    flac_put_bits(&writer, enc->bits_per_sample - 1, 5);
+    flac_put_bits(&writer, (uint32_t)(enc->total_frames >> 32), 4);
+    flac_put_bits(&writer, (uint32_t)enc->total_frames, 32);
+    for (int i = 0; i < 4; i++)
+    {
+        flac_put_bits(&writer, 0, 32); // MD5 not computed
+    }
+    return fwrite(header, 1, sizeof(header), enc->fp) == sizeof(header);
+}
+
+static void free_flac_encoder(FlacEncoder *enc)
+{
+    for (int c = 0; c < 4; c++)
+    {
+        free(enc->channels[c]);
+    }
+    free(enc->shifted);
+    free(enc->residual);
+    free(enc->best_residual);
+    free(enc->windowed);
+    free(enc->frame);
+    render_queue_free(&enc->queue);
+    free(enc);
+}
+
+// Create a FLAC file for stereo audio in an integer sample format and start the encoder thread
+FlacEncoder *flac_encoder_open(const char *filename, SampleFormat format, uint32_t sample_rate)
+{
+    if (format == SAMPLE_FORMAT_F32)
+    {
+        fprintf(stderr, "❌ FLAC stores integer samples: use --format s16, s16clip or s24\n");
+        return NULL;
+    }
+    FlacEncoder *enc = (FlacEncoder *)calloc(1, sizeof(FlacEncoder));
+    if (!enc)
+    {
+        fprintf(stderr, "❌ Failed to allocate FLAC encoder\n");
+        return NULL;
+    }
+    enc->format = format;
+    enc->bits_per_sample = sample_format_bytes(format) * 8;
+    enc->sample_rate = sample_rate;
+
+    // A coded frame is never larger than its verbatim subframes (at most 33 bits per sample) plus headers
+    int ok = render_queue_init(&enc->queue, FLAC_BLOCK_FRAMES * 2 * sizeof(int32_t));
+    for (int c = 0; c < 4; c++)
+    {
+        enc->channels[c] = (int32_t *)malloc(FLAC_BLOCK_FRAMES * sizeof(int32_t));
+        ok = ok && enc->channels[c];
+    }
+    enc->shifted = (int32_t *)malloc(FLAC_BLOCK_FRAMES * sizeof(int32_t));
+    enc->residual = (int32_t *)malloc(FLAC_BLOCK_FRAMES * sizeof(int32_t));
+    enc->best_residual = (int32_t *)malloc(FLAC_BLOCK_FRAMES * sizeof(int32_t));
+    enc->windowed = (double *)malloc(FLAC_BLOCK_FRAMES * sizeof(double));
+    enc->frame = (uint8_t *)malloc(2 * (FLAC_BLOCK_FRAMES * 5 + 64) + 64);
+    if (!ok || !enc->shifted || !enc->residual || !enc->best_residual || !enc->windowed || !enc->frame)
+    {
+        fprintf(stderr, "❌ Failed to allocate FLAC encoder\n");
+        free_flac_encoder(enc);
+        return NULL;
+    }
+
+    enc->fp = fopen(filename, "wb");
+    if (!enc->fp)
+    {
+        fprintf(stderr, "❌ Failed to open %s for writing\n", filename);
+        free_flac_encoder(enc);
+        return NULL;
+    }
+    flac_init_crc_tables();
+    enc->write_failed = !flac_write_stream_header(enc);
+    if (ma_thread_create(&enc->thread, ma_thread_priority_normal, 0, flac_encoder_thread, enc, NULL) != MA_SUCCESS)
+    {
+        fprintf(stderr, "❌ Failed to start the FLAC encoder thread\n");
+        fclose(enc->fp);
+        free_flac_encoder(enc);
+        return NULL;
+    }
+    return enc;
+}
+
+// Queue frames in the encoder's sample format (waits while the encoder thread is RENDER_QUEUE_BLOCKS behind)
+void flac_encoder_write(FlacEncoder *enc, const uint8_t *data, size_t frames)
+{
+    size_t bytes_per_value = sample_format_bytes(enc->format);
+    while (frames > 0)
+    {
+        if (!enc->pending)
+        {
+            enc->pending = (int32_t *)render_queue_begin_write(&enc->queue);
+            enc->pending_frames = 0;
+        }
+        size_t count = FLAC_BLOCK_FRAMES - enc->pending_frames;
+        count = frames < count ? frames : count;
+        int32_t *out = enc->pending + enc->pending_frames * 2;
+        for (size_t i = 0; i < count * 2; i++, data += bytes_per_value)
+        {
+            if (bytes_per_value == 3)
+            {
+                out[i] = (int32_t)((uint32_t)data[0] << 8 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 24) >> 8;
+            }
+            else
+            {
+                int16_t value;
+                memcpy(&value, data, sizeof(value));
+                out[i] = value;
+            }
+        }
+        enc->pending_frames += count;
+        frames -= count;
+        if (enc->pending_frames == FLAC_BLOCK_FRAMES)
+        {
+            render_queue_end_write(&enc->queue, FLAC_BLOCK_FRAMES);
+            enc->pending = NULL;
+        }
+    }
+}
+
+// Encode the queued frames, patch STREAMINFO and close the file, returns 0 if writing failed
+int flac_encoder_close(FlacEncoder *enc, const char *filename)
+{
+    if (enc->pending && enc->pending_frames > 0)
+    {
+        render_queue_end_write(&enc->queue, enc->pending_frames);
+    }
+    render_queue_finish(&enc->queue);
+    ma_thread_wait(&enc->thread);
+
+    int ok = !enc->write_failed && fseek(enc->fp, 0, SEEK_SET) == 0 && flac_write_stream_header(enc);
+    ok = fclose(enc->fp) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "❌ Failed to write %s\n", filename);
+    }
+    else
+    {
+        uint64_t pcm_bytes = enc->total_frames * 2 * (enc->bits_per_sample / 8);
+        printf("✅ Saved FLAC file: %s (%s, %.1f%% of the PCM size, encoded in %.1f ms)\n", filename,
+               sample_format_name(enc->format),
+               pcm_bytes ? (enc->bytes_written + FLAC_STREAMINFO_OFFSET + 34) * 100.0 / pcm_bytes : 0.0,
+               enc->encode_ms);
+    }
+    free_flac_encoder(enc);
+    return ok;
+}
+
+// Save a whole recording (raw DAC output, see sample_convert.h) as a FLAC file
+int save_flac_file(const char *filename, const int32_t *buffer, uint32_t num_samples, SampleFormat format)
+{
+    FlacEncoder *enc = flac_encoder_open(filename, format, INTERNAL_SAMPLE_RATE);
+    if (!enc)
+    {
+        return 0;
+    }
+    uint8_t block[INTERNAL_BUFFER_SIZE * 2 * 3];
+    size_t total_values = (size_t)num_samples * 2;
+    for (size_t i = 0; i < total_values; i += INTERNAL_BUFFER_SIZE * 2)
+    {
+        size_t count = total_values - i;
+        count = count > INTERNAL_BUFFER_SIZE * 2 ? INTERNAL_BUFFER_SIZE * 2 : count;
+        convert_samples(format, buffer + i, block, count);
+        flac_encoder_write(enc, block, count / 2);
+    }
+    return flac_encoder_close(enc, filename);
+}
+
+#endif // FLAC_ENCODER_H
@@ -1,9 +1,34 @@
-#include "types.h"
+#ifndef JSON_LOADER_H
+#define JSON_LOADER_H
+
+#include "events.h"
+
+#ifndef _WIN32
+#include <unistd.h> // sysconf
+#endif
 
 // Simple JSON parser for YM2151 log format
 // Expected format: {"events": [{"time": 0, "addr": "0x08", "data": "0x00"}, ...]}
 // Input is always treated as pass1 format (simple register writes) and converted to pass2 format
 // Note: "is_data" field in input JSON is ignored
+// Events may be in any time order (e.g. logs merged from several captures): they are sorted by time, and
+// events with the same time keep their order in the file
+// Optional loop marker: {"loop_start": 44100, "loop_end": 88200, "events": [...]} (pass1 times, loop_end defaults
+// to the end of the events). Playback wraps from the loop end back to the loop start (see loop_playback.h).
+
+// Parallel JSON parsing: one chunk of the log text per thread
+#define JSON_PARSE_MIN_CHUNK_BYTES (4 * 1024 * 1024) // Smaller logs (or chunks) are parsed on one thread
+#define JSON_PARSE_MAX_THREADS 64
+
+typedef struct
+{
+    const char *start;       // First "time": key of the chunk
+    const char *end;         // First "time": key of the next chunk (NULL = end of the text)
+    const char *next;        // First "time": key left unparsed (must be 'end' for the chunks to join up)
+    int stopped;             // An event without "addr" or "data" ended the parse
+    RegisterEventList *list; // Pass1 events of the chunk
+    ma_thread thread;
+} JsonParseChunk;
 
 // Parse hex string (e.g., "0x08" -> 8)
 static uint8_t parse_hex(const char *str)
@@ -50,53 +75,57 @@ static uint32_t parse_uint(const char *str)
 }
 
 // Find the next occurrence of a string in buffer
-static char *find_str(char *buffer, const char *search)
+static char *find_str(const char *buffer, const char *search)
 {
     return strstr(buffer, search);
 }
 
-// Load events from JSON file
-RegisterEventList *load_events_json(const char *filename)
+// Parse the unsigned integer value of "key": anywhere in the text, returns 0 if the key is missing
+static int parse_uint_key(const char *json, const char *key, uint32_t *value)
 {
-    FILE *fp = fopen(filename, "r");
-    if (!fp)
-    {
-        fprintf(stderr, "❌ Failed to open %s for reading\n", filename);
-        return NULL;
-    }
-
-    // Get file size
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    const char *pos = find_str(json, key);
+    if (!pos)
+        return 0;
+    pos += strlen(key);
+    while (*pos == ' ')
+        pos++;
+    if (*pos < '0' || *pos > '9')
+        return 0;
+    *value = parse_uint(pos);
+    return 1;
+}
 
-    // Read entire file
-    char *buffer = (char *)malloc(file_size + 1);
-    if (!buffer)
+// Parse the optional loop marker
+static void parse_loop_marker(const char *json, LoopMarker *loop)
+{
+    memset(loop, 0, sizeof(LoopMarker));
+    if (!parse_uint_key(json, "\"loop_start\":", &loop->start_time))
+        return;
+    loop->has_end = (uint8_t)parse_uint_key(json, "\"loop_end\":", &loop->end_time);
+    if (loop->has_end && loop->end_time <= loop->start_time)
     {
-        fprintf(stderr, "❌ Failed to allocate memory for JSON buffer\n");
-        fclose(fp);
-        return NULL;
+        fprintf(stderr, "⚠️  Loop marker ignored: loop_end %u is not after loop_start %u\n", loop->end_time,
+                loop->start_time);
+        return;
     }
+    loop->enabled = 1;
+}
 
-    size_t read_size = fread(buffer, 1, file_size, fp);
-    buffer[read_size] = '\0';
-    fclose(fp);
-
-    // Create event list
-    RegisterEventList *list = create_event_list();
-
-    // Simple parser - find each event object
-    char *pos = buffer;
-    while ((pos = find_str(pos, "\"time\":")) != NULL)
+// Parse the events whose "time": key lies before end (NULL = no limit), starting the search at pos
+// Returns the first "time": key left unparsed (NULL if there is none); *stopped is set if an event lacked
+// "addr" or "data", which ends the parse, and is -1 if the list ran out of memory
+static const char *parse_event_range(RegisterEventList *list, const char *pos, const char *end, int *stopped)
+{
+    *stopped = 0;
+    while ((pos = find_str(pos, "\"time\":")) != NULL && (!end || pos < end))
     {
-        pos += 7; // Skip "time":
-        while (*pos == ' ')
-            pos++;
-        uint32_t time = parse_uint(pos);
+        const char *time_pos = pos + 7; // Skip "time":
+        while (*time_pos == ' ')
+            time_pos++;
+        uint32_t time = parse_uint(time_pos);
 
         // Find addr
-        char *addr_pos = find_str(pos, "\"addr\":");
+        char *addr_pos = find_str(time_pos, "\"addr\":");
         if (!addr_pos)
             break;
         addr_pos += 7; // Skip "addr":
@@ -105,7 +134,7 @@ RegisterEventList *load_events_json(const char *filename)
         uint8_t addr = parse_hex(addr_pos);
 
         // Find data
-        char *data_pos = find_str(pos, "\"data\":");
+        char *data_pos = find_str(time_pos, "\"data\":");
         if (!data_pos)
             break;
         data_pos += 7; // Skip "data":
@@ -115,13 +144,244 @@ RegisterEventList *load_events_json(const char *filename)
 
         // Input is always treated as pass1 format, so is_data is always 0
         // (any "is_data" field in the JSON is ignored)
-        add_event_with_flag(list, time, addr, data, 0);
+        if (!try_add_event_with_flag(list, time, addr, data, 0))
+        {
+            *stopped = -1;
+            return NULL;
+        }
 
         pos = data_pos + 1;
     }
+    *stopped = pos && (!end || pos < end);
+    return pos;
+}
+
+// Parse events from a NUL-terminated JSON text without conversion (pass1 format), NULL if out of memory
+RegisterEventList *parse_events_json_pass1(const char *json)
+{
+    RegisterEventList *list = try_create_event_list();
+    if (!list)
+    {
+        return NULL;
+    }
+    int stopped;
+    parse_event_range(list, json, NULL, &stopped);
+    if (stopped < 0 || try_sort_events_by_time(list) < 0) // Playback and the pass2 conversion need time order
+    {
+        free_event_list(list);
+        return NULL;
+    }
+    parse_loop_marker(json, &list->loop);
+    return list;
+}
+
+// Parallel parsing
+// The text is split at "time": keys into one chunk per thread; each thread parses its chunk into its own
+// list and the lists are joined in order. A chunk's last event may read its "addr" and "data" keys from
+// the next chunk, exactly as the sequential parser does. The result equals parse_events_json_pass1: if
+// a chunk does not end where the next one starts (an event that skips over the following "time": key,
+// or a truncated event) or a chunk runs out of memory, the text is parsed again on one thread.
+
+static int json_parse_cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+static ma_thread_result MA_THREADCALL json_parse_chunk_thread(void *user_data)
+{
+    JsonParseChunk *chunk = (JsonParseChunk *)user_data;
+    chunk->next = parse_event_range(chunk->list, chunk->start, chunk->end, &chunk->stopped);
+    return (ma_thread_result)0;
+}
+
+// Parse events from a NUL-terminated JSON text of size bytes on up to 'threads' threads
+// threads: 0 = one per CPU, limited to one per JSON_PARSE_MIN_CHUNK_BYTES of text
+// Returns NULL if out of memory
+RegisterEventList *parse_events_json_pass1_parallel(const char *json, size_t size, int threads)
+{
+    if (threads <= 0)
+    {
+        size_t by_size = size / JSON_PARSE_MIN_CHUNK_BYTES;
+        threads = json_parse_cpu_count();
+        if ((size_t)threads > by_size)
+        {
+            threads = by_size > 0 ? (int)by_size : 1;
+        }
+    }
+    if (threads > JSON_PARSE_MAX_THREADS)
+    {
+        threads = JSON_PARSE_MAX_THREADS;
+    }
+
+    // Chunk boundaries: the first "time": key at or after each nominal offset (duplicates dropped)
+    JsonParseChunk chunks[JSON_PARSE_MAX_THREADS];
+    int count = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        const char *start = find_str(json + size / threads * i, "\"time\":");
+        if (!start || (count > 0 && start <= chunks[count - 1].start))
+        {
+            continue;
+        }
+        memset(&chunks[count], 0, sizeof(JsonParseChunk));
+        chunks[count].start = start;
+        count++;
+    }
+    if (count < 2)
+    {
+        return parse_events_json_pass1(json);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        chunks[i].end = i + 1 < count ? chunks[i + 1].start : NULL;
+        chunks[i].list = try_create_event_list();
+        if (!chunks[i].list)
+        {
+            while (i-- > 0)
+            {
+                free_event_list(chunks[i].list);
+            }
+            return parse_events_json_pass1(json);
+        }
+    }
+
+    // The calling thread parses the first chunk
+    int started = 1;
+    while (started < count && ma_thread_create(&chunks[started].thread, ma_thread_priority_normal, 0,
+                                               json_parse_chunk_thread, &chunks[started], NULL) == MA_SUCCESS)
+    {
+        started++;
+    }
+    json_parse_chunk_thread(&chunks[0]);
+    for (int i = 1; i < count; i++)
+    {
+        if (i < started)
+        {
+            ma_thread_wait(&chunks[i].thread);
+        }
+        else
+        {
+            json_parse_chunk_thread(&chunks[i]); // Thread could not be created
+        }
+    }
+
+    // Join the lists if every chunk ended where the next one starts
+    int joined = 1;
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        joined &= chunks[i].stopped >= 0 && (i + 1 == count || (!chunks[i].stopped && chunks[i].next == chunks[i].end));
+        total += chunks[i].list->count;
+    }
+    RegisterEventList *list = NULL;
+    if (joined)
+    {
+        list = try_create_event_list();
+    }
+    if (list && total > list->capacity)
+    {
+        RegisterEvent *events = (RegisterEvent *)realloc(list->events, sizeof(RegisterEvent) * total);
+        if (events)
+        {
+            list->events = events;
+            list->capacity = total;
+        }
+        else
+        {
+            free_event_list(list);
+            list = NULL;
+        }
+    }
+    if (list)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            memcpy(list->events + list->count, chunks[i].list->events, chunks[i].list->count * sizeof(RegisterEvent));
+            list->count += chunks[i].list->count;
+        }
+    }
+    for (int i = 0; i < count; i++)
+    {
+        free_event_list(chunks[i].list);
+    }
+    if (!list)
+    {
+        return parse_events_json_pass1(json);
+    }
+    if (try_sort_events_by_time(list) < 0)
+    {
+        free_event_list(list);
+        return NULL;
+    }
+    parse_loop_marker(json, &list->loop);
+    return list;
+}
+
+// Load events from JSON file without conversion (pass1 format: one event per register write)
+RegisterEventList *load_events_json_pass1(const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "❌ Failed to open %s for reading\n", filename);
+        return NULL;
+    }
+
+    // Get file size
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    // Read entire file
+    char *buffer = (char *)malloc(file_size + 1);
+    if (!buffer)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for JSON buffer\n");
+        fclose(fp);
+        return NULL;
+    }
+
+    size_t read_size = fread(buffer, 1, file_size, fp);
+    buffer[read_size] = '\0';
+    fclose(fp);
 
+    RegisterEventList *list = parse_events_json_pass1_parallel(buffer, read_size, 0);
     free(buffer);
+    if (!list)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for events\n");
+        return NULL;
+    }
     printf("✅ Loaded %zu events from %s\n", list->count, filename);
+    if (list->loop.enabled)
+    {
+        if (list->loop.has_end)
+        {
+            printf("Loop marker: start %u, end %u samples\n", list->loop.start_time, list->loop.end_time);
+        }
+        else
+        {
+            printf("Loop marker: start %u samples, end after the last event\n", list->loop.start_time);
+        }
+    }
+    return list;
+}
+
+// Load events from JSON file and convert them to pass2 format
+RegisterEventList *load_events_json(const char *filename)
+{
+    RegisterEventList *list = load_events_json_pass1(filename);
+    if (!list)
+    {
+        return NULL;
+    }
 
     // Always convert pass1 format to pass2 format (split register writes with delays)
     if (list->count > 0)
@@ -148,6 +408,7 @@ int save_events_json(const char *filename, RegisterEventList *events)
     // Write JSON header
     fprintf(fp, "{\n");
     fprintf(fp, "  \"event_count\": %zu,\n", events->count);
+    save_loop_marker_json(fp, &events->loop);
     fprintf(fp, "  \"events\": [\n");
 
     // Write each event
@@ -172,3 +433,5 @@ int save_events_json(const char *filename, RegisterEventList *events)
     printf("✅ Saved %zu events to %s (pass2 format)\n", events->count, filename);
     return 1;
 }
+
+#endif // JSON_LOADER_H
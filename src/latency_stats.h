@@ -0,0 +1,202 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include "types.h"
+
+// Audio callback latency histogram
+// Durations are recorded in nanoseconds into log-bucketed bins (8 sub-buckets per power of two,
+// ~9% relative resolution). The audio thread is the only writer; counters are atomic so the
+// main thread can read them at any time without locks.
+
+#define LATENCY_SUB_BUCKETS 8                                     // Buckets per power of two
+#define LATENCY_BUCKET_COUNT ((35 - 2) * LATENCY_SUB_BUCKETS + 8) // Up to 2^35 ns (~34 s)
+#define LATENCY_WORST_COUNT 8                                     // Number of worst spikes kept
+
+typedef struct
+{
+    uint64_t duration_ns;    // Callback processing time
+    uint64_t callback_index; // Callback number (0 = first)
+    double time_ms;          // Callback start time since playback start
+} LatencySpike;
+
+typedef struct
+{
+    ma_atomic_uint32 buckets[LATENCY_BUCKET_COUNT];
+    ma_atomic_uint64 count;       // Number of recorded callbacks
+    ma_atomic_uint64 over_budget; // Callbacks slower than the device period
+    uint64_t budget_ns;           // Device period
+    struct timespec start_time;   // Reference for spike timestamps
+    LatencySpike worst[LATENCY_WORST_COUNT];
+} LatencyStats;
+
+// Bucket index for a duration in nanoseconds
+static uint32_t latency_bucket_index(uint64_t ns)
+{
+    if (ns < LATENCY_SUB_BUCKETS)
+    {
+        return (uint32_t)ns; // Linear for the smallest values
+    }
+    uint32_t msb = 0;
+    while ((ns >> (msb + 1)) != 0)
+    {
+        msb++;
+    }
+    uint32_t sub = (uint32_t)(ns >> (msb - 3)) & (LATENCY_SUB_BUCKETS - 1);
+    uint32_t index = (msb - 2) * LATENCY_SUB_BUCKETS + sub;
+    return index < LATENCY_BUCKET_COUNT ? index : LATENCY_BUCKET_COUNT - 1;
+}
+
+// Lower bound of a bucket in nanoseconds
+static uint64_t latency_bucket_lower_ns(uint32_t index)
+{
+    if (index < LATENCY_SUB_BUCKETS)
+    {
+        return index;
+    }
+    uint32_t msb = index / LATENCY_SUB_BUCKETS + 2;
+    uint32_t sub = index % LATENCY_SUB_BUCKETS;
+    return (uint64_t)(LATENCY_SUB_BUCKETS + sub) << (msb - 3);
+}
+
+// Reset statistics, budget_ms is the device period (one buffer)
+void latency_stats_init(LatencyStats *stats, double budget_ms)
+{
+    memset(stats, 0, sizeof(LatencyStats));
+    stats->budget_ns = (uint64_t)(budget_ms * 1000000.0);
+    clock_gettime(CLOCK_MONOTONIC, &stats->start_time);
+}
+
+// Record one duration in nanoseconds, time_ms is when it happened relative to start_time (single writer)
+void latency_stats_record_ns(LatencyStats *stats, uint64_t ns, double time_ms)
+{
+    uint64_t index = ma_atomic_uint64_fetch_add(&stats->count, 1);
+
+    ma_atomic_uint32_fetch_add(&stats->buckets[latency_bucket_index(ns)], 1);
+    if (ns > stats->budget_ns)
+    {
+        ma_atomic_uint64_fetch_add(&stats->over_budget, 1);
+    }
+
+    // Keep the worst spikes sorted, longest first
+    int pos = LATENCY_WORST_COUNT;
+    while (pos > 0 && stats->worst[pos - 1].duration_ns < ns)
+    {
+        pos--;
+    }
+    if (pos < LATENCY_WORST_COUNT)
+    {
+        memmove(&stats->worst[pos + 1], &stats->worst[pos], (LATENCY_WORST_COUNT - pos - 1) * sizeof(LatencySpike));
+        stats->worst[pos].duration_ns = ns;
+        stats->worst[pos].callback_index = index;
+        stats->worst[pos].time_ms = time_ms;
+    }
+}
+
+// Record one callback duration (audio thread only)
+void latency_stats_record(LatencyStats *stats, const struct timespec *start_time, const struct timespec *end_time)
+{
+    int64_t ns = (int64_t)(end_time->tv_sec - start_time->tv_sec) * 1000000000 + (end_time->tv_nsec - start_time->tv_nsec);
+    if (ns < 0)
+    {
+        ns = 0;
+    }
+    latency_stats_record_ns(stats, (uint64_t)ns,
+                            (start_time->tv_sec - stats->start_time.tv_sec) * 1000.0 +
+                                (start_time->tv_nsec - stats->start_time.tv_nsec) / 1000000.0);
+}
+
+// Percentile (0-100) in milliseconds, reported as the upper bound of the bucket (capped at the exact maximum)
+double latency_stats_percentile_ms(LatencyStats *stats, double percentile)
+{
+    uint64_t max_ns = stats->worst[0].duration_ns;
+    uint64_t total = ma_atomic_uint64_get(&stats->count);
+    if (total == 0)
+    {
+        return 0.0;
+    }
+    uint64_t target = (uint64_t)ceil(total * percentile / 100.0);
+    if (target == 0)
+    {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        seen += ma_atomic_uint32_get(&stats->buckets[i]);
+        if (seen >= target)
+        {
+            uint64_t upper = i + 1 < LATENCY_BUCKET_COUNT ? latency_bucket_lower_ns(i + 1) : latency_bucket_lower_ns(i);
+            return (upper < max_ns ? upper : max_ns) / 1000000.0;
+        }
+    }
+    return latency_bucket_lower_ns(LATENCY_BUCKET_COUNT - 1) / 1000000.0;
+}
+
+// Print percentiles and worst spikes
+void print_latency_stats(LatencyStats *stats)
+{
+    uint64_t total = ma_atomic_uint64_get(&stats->count);
+    uint64_t over = ma_atomic_uint64_get(&stats->over_budget);
+    printf("  Latency percentiles: p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, p99.9 %.3f ms\n",
+           latency_stats_percentile_ms(stats, 50.0), latency_stats_percentile_ms(stats, 95.0),
+           latency_stats_percentile_ms(stats, 99.0), latency_stats_percentile_ms(stats, 99.9));
+    printf("  Over-budget callbacks: %llu / %llu (budget %.2f ms)\n",
+           (unsigned long long)over, (unsigned long long)total, stats->budget_ns / 1000000.0);
+    printf("  Worst spikes:\n");
+    for (int i = 0; i < LATENCY_WORST_COUNT && stats->worst[i].duration_ns > 0; i++)
+    {
+        printf("    %.3f ms at %.1f ms (callback #%llu)\n",
+               stats->worst[i].duration_ns / 1000000.0, stats->worst[i].time_ms,
+               (unsigned long long)stats->worst[i].callback_index);
+    }
+}
+
+// Save histogram, percentiles and worst spikes to JSON file
+int save_latency_json(const char *filename, LatencyStats *stats)
+{
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "❌ Failed to open %s for writing\n", filename);
+        return 0;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"callback_count\": %llu,\n", (unsigned long long)ma_atomic_uint64_get(&stats->count));
+    fprintf(fp, "  \"over_budget_count\": %llu,\n", (unsigned long long)ma_atomic_uint64_get(&stats->over_budget));
+    fprintf(fp, "  \"budget_ms\": %.3f,\n", stats->budget_ns / 1000000.0);
+    fprintf(fp, "  \"p50_ms\": %.3f,\n", latency_stats_percentile_ms(stats, 50.0));
+    fprintf(fp, "  \"p95_ms\": %.3f,\n", latency_stats_percentile_ms(stats, 95.0));
+    fprintf(fp, "  \"p99_ms\": %.3f,\n", latency_stats_percentile_ms(stats, 99.0));
+    fprintf(fp, "  \"p99_9_ms\": %.3f,\n", latency_stats_percentile_ms(stats, 99.9));
+
+    fprintf(fp, "  \"worst\": [");
+    for (int i = 0; i < LATENCY_WORST_COUNT && stats->worst[i].duration_ns > 0; i++)
+    {
+        fprintf(fp, "%s\n    {\"duration_ms\": %.3f, \"time_ms\": %.1f, \"callback\": %llu}", i ? "," : "",
+                stats->worst[i].duration_ns / 1000000.0, stats->worst[i].time_ms,
+                (unsigned long long)stats->worst[i].callback_index);
+    }
+    fprintf(fp, "\n  ],\n");
+
+    // Non-empty buckets only: [lower bound in microseconds, count]
+    fprintf(fp, "  \"histogram_us\": [");
+    int first = 1;
+    for (uint32_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        uint32_t n = ma_atomic_uint32_get(&stats->buckets[i]);
+        if (n)
+        {
+            fprintf(fp, "%s\n    [%.3f, %u]", first ? "" : ",", latency_bucket_lower_ns(i) / 1000.0, n);
+            first = 0;
+        }
+    }
+    fprintf(fp, "\n  ]\n");
+    fprintf(fp, "}\n");
+
+    fclose(fp);
+    printf("✅ Saved latency statistics to %s\n", filename);
+    return 1;
+}
+
+#endif // LATENCY_STATS_H
@@ -0,0 +1,438 @@
+#ifndef LIVE_INPUT_H
+#define LIVE_INPUT_H
+
+#include "event_stream.h"
+#include "json_loader.h"
+#include "latency_stats.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Streaming register write input for live rendering
+// A reader thread parses records from stdin or a UNIX socket and pushes them into a bounded
+// single-producer single-consumer queue. The audio callback pops events when they are due and
+// splits them into address/data writes with the same delays as convert_to_pass2_format.
+// Event times are relative: the first timed event is played 'lookahead' samples after it is dequeued
+// and the following ones keep their spacing from it. Events without a time are scheduled at
+// arrival + lookahead on the callback timeline, so the callback buffer does not quantize their
+// timing. A full queue blocks the reader on an event the audio thread signals when it frees a slot,
+// which bounds how far ahead input can be buffered.
+// The reported input-to-audio latency runs from the moment the reader thread has a record to the
+// time its data write is due on the callback timeline (callback start + sample offset). It leaves out
+// the device output latency, which is printed next to it.
+
+#define LIVE_QUEUE_SIZE 65536       // Pass1 events buffered between reader thread and audio thread (power of two)
+#define LIVE_TIME_NOW 0xFFFFFFFFu   // Event time meaning "as soon as possible"
+#define LIVE_WAV_MAX_SECONDS 300    // WAV capture limit in live mode and endless loop playback
+
+typedef enum
+{
+    LIVE_INPUT_JSONL = 0, // One {"time": N, "addr": "0x08", "data": "0x00"} object per line ("time" optional)
+    LIVE_INPUT_BINARY     // 6-byte records: uint32 little-endian time, address, data
+} LiveInputFormat;
+
+typedef struct
+{
+    uint32_t sample_time; // Requested pass1 time or LIVE_TIME_NOW
+    uint8_t address;
+    uint8_t data;
+    uint64_t arrival_ns;  // Monotonic clock when the record was read
+} LiveEvent;
+
+typedef struct LiveInput
+{
+    // Single-producer single-consumer queue (reader thread -> audio thread)
+    LiveEvent queue[LIVE_QUEUE_SIZE];
+    ma_atomic_uint32 head;           // Next event to read (audio thread)
+    ma_atomic_uint32 tail;           // Next slot to write (reader thread)
+    ma_atomic_bool32 eof;            // Set by the reader thread after the last event was queued
+    ma_event space;                  // Signaled by the audio thread when it frees a slot for a waiting reader
+    ma_atomic_bool32 reader_waiting; // Set while the reader thread finds the queue full
+
+    // Reader thread
+    ma_thread thread;
+    int thread_started;
+    LiveInputFormat format;
+    FILE *fp;
+    const char *socket_path; // NULL for stdin
+    int listen_fd;
+    uint64_t records_read;
+
+    // Audio thread state
+    uint32_t lookahead_samples;  // Scheduling delay of the first timed event and of LIVE_TIME_NOW events
+    int64_t time_base;           // Offset from event time to sample position (set by the first timed event)
+    int time_base_set;
+    uint64_t callback_ns;        // Timeline of the current callback: sample callback_sample is due at callback_ns
+    uint32_t callback_sample;
+    EventStreamCursor cursor;    // Pass2 split state (same delays as convert_to_pass2_format)
+    uint64_t current_arrival_ns; // Arrival of the event in 'cursor' (0 for timed events)
+    uint64_t late_count;         // Events that could not be played at their requested time
+    LatencyStats input_latency;  // Arrival to the data write's due time on the callback timeline (LIVE_TIME_NOW only)
+} LiveInput;
+
+static uint64_t live_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// Parse one JSON-lines record, returns 0 if the line holds no register write
+static int live_parse_jsonl(char *line, LiveEvent *event)
+{
+    char *addr_pos = find_str(line, "\"addr\":");
+    char *data_pos = find_str(line, "\"data\":");
+    if (!addr_pos || !data_pos)
+    {
+        return 0;
+    }
+    addr_pos += 7;
+    while (*addr_pos == ' ' || *addr_pos == '"')
+        addr_pos++;
+    data_pos += 7;
+    while (*data_pos == ' ' || *data_pos == '"')
+        data_pos++;
+    event->address = parse_hex(addr_pos);
+    event->data = parse_hex(data_pos);
+
+    char *time_pos = find_str(line, "\"time\":");
+    event->sample_time = LIVE_TIME_NOW;
+    if (time_pos)
+    {
+        time_pos += 7;
+        while (*time_pos == ' ')
+            time_pos++;
+        event->sample_time = parse_uint(time_pos);
+    }
+    return 1;
+}
+
+// Queue one event, waits while the queue is full (reader thread only)
+static void live_queue_push(LiveInput *live, const LiveEvent *event)
+{
+    uint32_t tail = ma_atomic_uint32_get(&live->tail);
+    while (tail - ma_atomic_uint32_get(&live->head) >= LIVE_QUEUE_SIZE)
+    {
+        // Announce the wait, then check again: either the audio thread sees the flag and signals,
+        // or this check sees its slot (the auto-reset event keeps a signal sent before the wait)
+        ma_atomic_bool32_set(&live->reader_waiting, MA_TRUE);
+        if (tail - ma_atomic_uint32_get(&live->head) >= LIVE_QUEUE_SIZE)
+        {
+            ma_event_wait(&live->space);
+        }
+        ma_atomic_bool32_set(&live->reader_waiting, MA_FALSE);
+    }
+    live->queue[tail & (LIVE_QUEUE_SIZE - 1)] = *event;
+    ma_atomic_uint32_set(&live->tail, tail + 1); // Publish after the event is stored
+}
+
+static ma_thread_result MA_THREADCALL live_input_thread(void *user_data)
+{
+    LiveInput *live = (LiveInput *)user_data;
+
+#ifndef _WIN32
+    if (live->socket_path)
+    {
+        int fd = accept(live->listen_fd, NULL, NULL);
+        if (fd < 0 || !(live->fp = fdopen(fd, "rb")))
+        {
+            fprintf(stderr, "❌ Failed to accept connection on %s\n", live->socket_path);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            ma_atomic_bool32_set(&live->eof, MA_TRUE);
+            return (ma_thread_result)0;
+        }
+    }
+#endif
+
+    LiveEvent event;
+    if (live->format == LIVE_INPUT_BINARY)
+    {
+        uint8_t record[6];
+        while (fread(record, 1, sizeof(record), live->fp) == sizeof(record))
+        {
+            event.arrival_ns = live_now_ns();
+            event.sample_time = (uint32_t)record[0] | ((uint32_t)record[1] << 8) | ((uint32_t)record[2] << 16) |
+                                ((uint32_t)record[3] << 24);
+            event.address = record[4];
+            event.data = record[5];
+            live_queue_push(live, &event);
+            live->records_read++;
+        }
+    }
+    else
+    {
+        char line[1024];
+        while (fgets(line, sizeof(line), live->fp))
+        {
+            event.arrival_ns = live_now_ns();
+            if (live_parse_jsonl(line, &event))
+            {
+                live_queue_push(live, &event);
+                live->records_read++;
+            }
+        }
+    }
+
+    ma_atomic_bool32_set(&live->eof, MA_TRUE);
+    return (ma_thread_result)0;
+}
+
+// Open input source: "-" for stdin, otherwise a UNIX socket path to listen on (one client)
+LiveInput *live_input_open(const char *source, LiveInputFormat format)
+{
+    LiveInput *live = (LiveInput *)calloc(1, sizeof(LiveInput));
+    if (!live)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for live input\n");
+        exit(1);
+    }
+    if (ma_event_init(&live->space) != MA_SUCCESS)
+    {
+        fprintf(stderr, "❌ Failed to initialize live input event\n");
+        free(live);
+        return NULL;
+    }
+    live->format = format;
+    live->listen_fd = -1;
+
+    if (strcmp(source, "-") == 0)
+    {
+        live->fp = stdin;
+#ifdef _WIN32
+        if (format == LIVE_INPUT_BINARY)
+        {
+            _setmode(_fileno(stdin), _O_BINARY);
+        }
+#endif
+        printf("✅ Live input: stdin (%s)\n", format == LIVE_INPUT_BINARY ? "binary" : "JSON lines");
+        return live;
+    }
+
+#ifdef _WIN32
+    fprintf(stderr, "❌ UNIX socket input is not supported on this platform, use stdin (-)\n");
+    ma_event_uninit(&live->space);
+    free(live);
+    return NULL;
+#else
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(source) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "❌ Socket path too long: %s\n", source);
+        ma_event_uninit(&live->space);
+        free(live);
+        return NULL;
+    }
+    strcpy(addr.sun_path, source);
+
+    live->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (live->listen_fd < 0)
+    {
+        fprintf(stderr, "❌ Failed to create socket\n");
+        ma_event_uninit(&live->space);
+        free(live);
+        return NULL;
+    }
+    unlink(source);
+    if (bind(live->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(live->listen_fd, 1) != 0)
+    {
+        fprintf(stderr, "❌ Failed to listen on %s\n", source);
+        close(live->listen_fd);
+        ma_event_uninit(&live->space);
+        free(live);
+        return NULL;
+    }
+    live->socket_path = source;
+    printf("✅ Live input: listening on %s (%s)\n", source, format == LIVE_INPUT_BINARY ? "binary" : "JSON lines");
+    return live;
+#endif
+}
+
+// Start the reader thread (after the audio device is running)
+int live_input_start(LiveInput *live)
+{
+    if (ma_thread_create(&live->thread, ma_thread_priority_normal, 0, live_input_thread, live, NULL) != MA_SUCCESS)
+    {
+        fprintf(stderr, "❌ Failed to start live input thread\n");
+        return 0;
+    }
+    live->thread_started = 1;
+    return 1;
+}
+
+// Wait for the reader thread and release the input
+void live_input_close(LiveInput *live)
+{
+    if (live->thread_started)
+    {
+        ma_thread_wait(&live->thread);
+    }
+#ifndef _WIN32
+    if (live->socket_path)
+    {
+        if (live->fp)
+        {
+            fclose(live->fp);
+        }
+        close(live->listen_fd);
+        unlink(live->socket_path);
+    }
+#endif
+    ma_event_uninit(&live->space);
+    free(live);
+}
+
+// Map wall clock to sample positions for the current callback (audio thread)
+void live_input_begin_callback(LiveInput *live, const struct timespec *now, uint32_t current_sample)
+{
+    live->callback_ns = (uint64_t)now->tv_sec * 1000000000 + (uint64_t)now->tv_nsec;
+    live->callback_sample = current_sample;
+}
+
+// Move cursor to the next pass2 event ('valid' is cleared while the queue is empty)
+static void live_input_advance(LiveInput *live, uint32_t current_sample)
+{
+    EventStreamCursor *cursor = &live->cursor;
+    if (cursor->data_pending)
+    {
+        // Data register write of the current pass1 event
+        cursor->current.sample_time = cursor->data_time;
+        cursor->current.is_data_write = 1;
+        cursor->data_pending = 0;
+        return;
+    }
+
+    uint32_t head = ma_atomic_uint32_get(&live->head);
+    if (head == ma_atomic_uint32_get(&live->tail))
+    {
+        cursor->valid = 0;
+        return;
+    }
+    LiveEvent event = live->queue[head & (LIVE_QUEUE_SIZE - 1)];
+    ma_atomic_uint32_set(&live->head, head + 1);
+    if (ma_atomic_bool32_get(&live->reader_waiting))
+    {
+        ma_event_signal(&live->space); // Only when the reader is blocked, the callback skips the lock otherwise
+    }
+
+    int64_t time;
+    if (event.sample_time == LIVE_TIME_NOW)
+    {
+        int64_t offset_ns = (int64_t)(event.arrival_ns - live->callback_ns);
+        time = (int64_t)live->callback_sample + offset_ns * INTERNAL_SAMPLE_RATE / 1000000000 + live->lookahead_samples;
+        live->current_arrival_ns = event.arrival_ns;
+    }
+    else
+    {
+        if (!live->time_base_set)
+        {
+            live->time_base = (int64_t)current_sample + live->lookahead_samples - event.sample_time;
+            live->time_base_set = 1;
+        }
+        time = event.sample_time + live->time_base;
+        live->current_arrival_ns = 0;
+    }
+    if (time < 0)
+    {
+        time = 0; // Counted as late below
+    }
+
+    // Reset accumulated delay when the time changes
+    if ((uint32_t)time != cursor->group_time)
+    {
+        cursor->accumulated_delay = 0;
+        cursor->group_time = (uint32_t)time;
+    }
+    if (time + cursor->accumulated_delay < current_sample)
+    {
+        // Too late, play now (later events of the same time keep following it)
+        cursor->accumulated_delay = current_sample - (uint32_t)time;
+        live->late_count++;
+    }
+
+    cursor->current.address = event.address;
+    cursor->current.data = event.data;
+    cursor->current.sample_time = (uint32_t)time + cursor->accumulated_delay;
+    cursor->current.is_data_write = 0;
+    cursor->accumulated_delay += DELAY_SAMPLES;
+    cursor->data_time = (uint32_t)time + cursor->accumulated_delay;
+    cursor->accumulated_delay += DELAY_SAMPLES;
+    cursor->data_pending = 1;
+    cursor->valid = 1;
+}
+
+// Write all events due at current_sample (audio thread)
+// Returns 1 once the input is closed and every queued event has been written
+int live_input_process_until(LiveInput *live, opm_t *chip, uint32_t current_sample)
+{
+    EventStreamCursor *cursor = &live->cursor;
+    for (;;)
+    {
+        if (!cursor->valid)
+        {
+            // Read the flag before the queue so events queued just before the end are not missed
+            ma_bool32 eof = ma_atomic_bool32_get(&live->eof);
+            live_input_advance(live, current_sample);
+            if (!cursor->valid)
+            {
+                return eof ? 1 : 0;
+            }
+        }
+        if (cursor->current.sample_time > current_sample)
+        {
+            return 0;
+        }
+
+        if (cursor->current.is_data_write)
+        {
+            OPM_Write(chip, OPM_DATA_REGISTER, cursor->current.data);
+
+            // Input-to-audio latency: arrival to the point on the callback timeline where this sample is due
+            if (live->current_arrival_ns)
+            {
+                int64_t due_ns = (int64_t)live->callback_ns +
+                                 (int64_t)(current_sample - live->callback_sample) * 1000000000 / INTERNAL_SAMPLE_RATE;
+                int64_t ns = due_ns - (int64_t)live->current_arrival_ns;
+                uint64_t start_ns = (uint64_t)live->input_latency.start_time.tv_sec * 1000000000 +
+                                    (uint64_t)live->input_latency.start_time.tv_nsec;
+                latency_stats_record_ns(&live->input_latency, ns > 0 ? (uint64_t)ns : 0,
+                                        ((int64_t)live->current_arrival_ns - (int64_t)start_ns) / 1000000.0);
+            }
+        }
+        else
+        {
+            OPM_Write(chip, OPM_ADDRESS_REGISTER, cursor->current.address);
+        }
+        live_input_advance(live, current_sample);
+    }
+}
+
+// Print input statistics (after the reader thread has finished)
+void print_live_input_stats(LiveInput *live, double buffer_duration_ms)
+{
+    LatencyStats *stats = &live->input_latency;
+    printf("Live input statistics:\n");
+    printf("  Records received: %llu\n", (unsigned long long)live->records_read);
+    printf("  Late events (played after their requested time): %llu\n", (unsigned long long)live->late_count);
+    if (ma_atomic_uint64_get(&stats->count) > 0)
+    {
+        printf("  Input-to-audio latency (untimed events, lookahead %.2f ms):\n", stats->budget_ns / 1000000.0);
+        printf("    (record arrival to its data write's due time on the callback timeline)\n");
+        printf("    p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+               latency_stats_percentile_ms(stats, 50.0), latency_stats_percentile_ms(stats, 95.0),
+               latency_stats_percentile_ms(stats, 99.0), stats->worst[0].duration_ns / 1000000.0);
+        printf("    (plus device output latency, about one buffer: %.2f ms)\n", buffer_duration_ms);
+    }
+}
+
+#endif // LIVE_INPUT_H
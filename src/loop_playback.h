@@ -0,0 +1,166 @@
+#ifndef LOOP_PLAYBACK_H
+#define LOOP_PLAYBACK_H
+
+#include "audio_context.h"
+#include "events.h"
+#include "event_stream.h"
+
+// Loop-point playback
+// A log with a loop marker plays its intro once and then repeats the loop body: when the song position
+// reaches the loop end, samples_played is set back to the loop start and the pass2 event index (or the
+// compact stream cursor) to the first write of the body. The chip keeps running, so the wrap is seamless.
+// Since the song position never passes the song length, counters and memory stay bounded however long
+// the session runs (the elapsed time is wrapped_samples + samples_played).
+// Playback ends after a loop count (the events after the loop end and the usual one second tail follow
+// the last pass) or a duration limit, whichever comes first.
+
+#define LOOP_FOREVER UINT32_MAX // Loop count without limit (until a duration limit or the process is stopped)
+
+typedef struct LoopPlayback
+{
+    uint32_t start_sample;          // Song position after a wrap (loop start time)
+    uint32_t end_sample;            // Song position of the wrap (loop end, at the earliest after the last body write)
+    size_t start_index;             // Pass2 event array: first event of the loop body
+    EventStreamCursor start_cursor; // Compact stream: cursor at the first event of the loop body
+    uint32_t wraps_left;            // LOOP_FOREVER = no loop count limit
+    uint32_t song_end;              // Song position at which the last pass ends (last event + 1 second)
+    uint64_t duration_limit;        // Total samples to play (0 = no limit)
+    uint64_t wrapped_samples;       // Samples played before the current pass
+    uint64_t wraps;                 // Completed wraps
+} LoopPlayback;
+
+// Locate the loop body of an event array or compact stream and set the limits, returns 0 if the body is empty
+// loops: passes through the loop body (LOOP_FOREVER = no limit), duration_limit: samples (0 = no limit)
+int loop_playback_init(LoopPlayback *loop, const LoopMarker *marker, const RegisterEventList *events,
+                       const EventStream *stream, uint32_t loops, uint32_t song_samples, uint64_t duration_limit)
+{
+    memset(loop, 0, sizeof(LoopPlayback));
+    loop->start_sample = marker->start_time;
+
+    // Writes are issued in list order, so the last body write is due at the latest time up to the body end
+    uint32_t last_write = 0;
+    int has_body = 0;
+    if (stream)
+    {
+        // Pass1 event boundaries are the address writes (cursor.time is the pass1 time of 'current')
+        EventStreamCursor cursor;
+        int in_body = 0;
+        for (event_stream_rewind(stream, &cursor); cursor.valid; event_stream_advance(stream, &cursor))
+        {
+            if (!cursor.current.is_data_write)
+            {
+                if (marker->has_end && cursor.time >= marker->end_time)
+                {
+                    break;
+                }
+                if (!in_body && cursor.time >= marker->start_time)
+                {
+                    loop->start_cursor = cursor;
+                    in_body = 1;
+                }
+            }
+            has_body |= in_body;
+            if (cursor.current.sample_time > last_write)
+            {
+                last_write = cursor.current.sample_time;
+            }
+        }
+    }
+    else
+    {
+        loop->start_index = marker->start_index;
+        has_body = marker->start_index < marker->end_index;
+        for (size_t i = 0; i < marker->end_index; i++)
+        {
+            if (events->events[i].sample_time > last_write)
+            {
+                last_write = events->events[i].sample_time;
+            }
+        }
+    }
+    if (!has_body)
+    {
+        return 0;
+    }
+
+    // Writes still pending at loop_end delay the wrap
+    loop->end_sample = marker->has_end && marker->end_time > last_write ? marker->end_time : last_write + 1;
+    loop->wraps_left = loops == LOOP_FOREVER ? LOOP_FOREVER : loops - 1;
+    loop->song_end = song_samples > loop->end_sample ? song_samples : loop->end_sample;
+    loop->duration_limit = duration_limit;
+    return 1;
+}
+
+// End of the current pass for AudioContext.total_samples: song end after the last wrap, or the duration limit
+uint32_t loop_playback_total_samples(const LoopPlayback *loop)
+{
+    uint64_t total = loop->wraps_left ? UINT32_MAX : loop->song_end;
+    if (loop->duration_limit && loop->duration_limit - loop->wrapped_samples < total)
+    {
+        total = loop->duration_limit - loop->wrapped_samples;
+    }
+    return (uint32_t)total;
+}
+
+// Length of the whole session in samples: intro, all passes and the tail, or the duration limit if it comes
+// first (UINT64_MAX = endless)
+uint64_t loop_playback_length(const LoopPlayback *loop)
+{
+    uint64_t length = loop->duration_limit ? loop->duration_limit : UINT64_MAX;
+    if (loop->wraps_left != LOOP_FOREVER)
+    {
+        uint64_t passes = loop->wrapped_samples + loop->song_end +
+                          (uint64_t)loop->wraps_left * (loop->end_sample - loop->start_sample);
+        length = passes < length ? passes : length;
+    }
+    return length;
+}
+
+// Wrap to the loop start if the song position reached the loop end and passes are left (before each sample)
+void loop_playback_wrap(AudioContext *ctx)
+{
+    LoopPlayback *loop = ctx->loop;
+    if (ctx->samples_played < loop->end_sample || loop->wraps_left == 0)
+    {
+        return;
+    }
+    if (loop->wraps_left != LOOP_FOREVER)
+    {
+        loop->wraps_left--;
+    }
+    loop->wrapped_samples += ctx->samples_played - loop->start_sample;
+    loop->wraps++;
+    ctx->samples_played = loop->start_sample;
+    if (ctx->stream)
+    {
+        ctx->stream_cursor = loop->start_cursor;
+    }
+    else
+    {
+        ctx->next_event_index = loop->start_index;
+    }
+    ctx->total_samples = loop_playback_total_samples(loop);
+}
+
+void print_loop_playback(const LoopPlayback *loop, uint32_t loops)
+{
+    printf("Loop playback:\n");
+    printf("  Loop body: %.3f s to %.3f s (%.3f s)\n", (double)loop->start_sample / INTERNAL_SAMPLE_RATE,
+           (double)loop->end_sample / INTERNAL_SAMPLE_RATE,
+           (double)(loop->end_sample - loop->start_sample) / INTERNAL_SAMPLE_RATE);
+    if (loops == LOOP_FOREVER)
+    {
+        printf("  Passes: endless\n");
+    }
+    else
+    {
+        printf("  Passes: %u\n", loops);
+    }
+    if (loop->duration_limit)
+    {
+        printf("  Duration limit: %.3f s\n", (double)loop->duration_limit / INTERNAL_SAMPLE_RATE);
+    }
+    printf("\n");
+}
+
+#endif // LOOP_PLAYBACK_H
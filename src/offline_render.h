@@ -0,0 +1,462 @@
+#ifndef OFFLINE_RENDER_H
+#define OFFLINE_RENDER_H
+
+#include "audio_context.h"
+#include "core.h"
+#include "loop_playback.h"
+#include "playlist.h"
+#include "render_queue.h"
+#include "sample_convert.h"
+#include "wav_writer.h"
+
+// Offline rendering straight to a WAV, RF64, W64 or FLAC file (no audio device)
+// The work is split into three stages on blocks of RENDER_BLOCK_FRAMES frames:
+//   emulate (events + OPM_Clock) -> resample + convert to the output format -> write to the file
+// Sequential mode runs the stages one after another on the calling thread. Pipelined mode gives
+// emulation and conversion their own threads and writes on the calling thread; the stages are
+// connected by bounded single-producer single-consumer queues (render_queue.h), so resampling,
+// conversion and file I/O overlap with emulation and the render runs at OPM_Clock speed. FLAC output
+// hands the converted blocks to the encoder thread (flac_encoder.h) in the write stage.
+// Output and stems are streamed through AudioWriter (wav_writer.h), so memory use does not grow with the
+// length of the render. Stems travel with the master through the same blocks: emulation appends the
+// per-channel values to each raw block, conversion turns them into one section per channel after the
+// output frames, and the write stage opens a stem file at the first non-silent block of its channel
+// (writing the silence before it). Stems are not resampled.
+
+#define RENDER_BLOCK_FRAMES 4096 // Stereo frames per pipeline block
+
+typedef enum
+{
+    RENDER_REALTIME = 0, // Play through the audio device
+    RENDER_SEQUENTIAL,   // Emulate, convert and write one block after another on one thread
+    RENDER_PIPELINED     // One thread per stage connected by bounded queues
+} RenderMode;
+
+typedef struct
+{
+    SampleFormat format;
+    uint32_t output_rate;
+    ma_resampler resampler; // Only used when output_rate differs from INTERNAL_SAMPLE_RATE
+    int resample;
+    int32_t *raw;           // Emulation output block (sequential mode)
+    float *resample_in;
+    float *resample_out;
+    int32_t *resampled;
+    uint8_t *encoded;       // Converted block (sequential mode)
+    size_t max_out_frames;  // Output frames per block after resampling
+    AudioContext *ctx;      // Emulation state (events, chip, total_samples)
+    AudioWriter *output;
+    AudioContainer container;
+    const char *stem_prefix;              // Stems go to <prefix>_ch1.wav .. _ch8.wav (NULL = no stems)
+    AudioWriter *stems[STEM_CHANNELS];    // Opened at the first non-silent block of each channel
+    int32_t *stem_channel;                // One channel of a raw block (conversion stage)
+    size_t stem_offset;                   // Stem section of an encoded block (after the output frames)
+    uint64_t stem_frames;                 // Stem frames written (earlier silence is filled in for late stems)
+    uint64_t expected_frames;             // Output length at the internal rate (0 = unknown)
+    int stems_failed;
+    double stage_ms[3];     // Busy time of emulate, convert and write
+    RenderQueue raw_queue;
+    RenderQueue encoded_queue;
+} OfflineRender;
+
+// Frames the render will produce at the internal rate, 0 if unknown (live input, playlist)
+static uint64_t render_expected_samples(const AudioContext *ctx)
+{
+    if (ctx->live || ctx->playlist)
+    {
+        return 0;
+    }
+    if (ctx->loop)
+    {
+        uint64_t length = loop_playback_length(ctx->loop);
+        return length == UINT64_MAX ? 0 : length - playback_elapsed_samples(ctx);
+    }
+    return ctx->total_samples > ctx->samples_played ? ctx->total_samples - ctx->samples_played : 0;
+}
+
+static double render_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Stage 1: emulate up to one block, returns the number of frames (0 at the end)
+static uint32_t render_emulate(OfflineRender *render, int32_t *raw)
+{
+    AudioContext *ctx = render->ctx;
+    uint32_t frames = 0;
+    while (frames < RENDER_BLOCK_FRAMES)
+    {
+        // Playlist: wait for the next log instead of playing silence
+        if (ctx->samples_played >= ctx->total_samples &&
+            (!ctx->playlist || playlist_next_song(ctx, 1) != PLAYLIST_SWITCHED))
+        {
+            break;
+        }
+        generate_sample(ctx, &raw[frames * 2]);
+        if (render->stem_prefix)
+        {
+            OPM_GetStems(&ctx->chip, &raw[RENDER_BLOCK_FRAMES * 2 + frames * STEM_VALUES_PER_FRAME]);
+        }
+        ctx->samples_played++;
+        frames++;
+    }
+    return frames;
+}
+
+// Stem section of an encoded block: the frame count, then one converted block per channel
+static void render_convert_stems(OfflineRender *render, const int32_t *raw, uint32_t frames, uint8_t *out)
+{
+    const int32_t *stems = raw + RENDER_BLOCK_FRAMES * 2;
+    uint8_t *section = out + render->stem_offset;
+    size_t block_bytes = RENDER_BLOCK_FRAMES * 2 * sample_format_bytes(render->format);
+    size_t count = frames;
+    memcpy(section, &count, sizeof(size_t));
+    for (int ch = 0; ch < STEM_CHANNELS; ch++)
+    {
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            render->stem_channel[i * 2] = stems[(size_t)i * STEM_VALUES_PER_FRAME + ch * 2];
+            render->stem_channel[i * 2 + 1] = stems[(size_t)i * STEM_VALUES_PER_FRAME + ch * 2 + 1];
+        }
+        convert_samples(render->format, render->stem_channel, section + sizeof(size_t) + ch * block_bytes,
+                        (size_t)frames * 2);
+    }
+}
+
+// Stage 2: resample (optional) and convert one block, returns the number of output frames
+static size_t render_convert(OfflineRender *render, const int32_t *raw, uint32_t frames, uint8_t *out)
+{
+    if (render->stem_prefix)
+    {
+        render_convert_stems(render, raw, frames, out);
+    }
+    if (!render->resample)
+    {
+        convert_samples(render->format, raw, out, (size_t)frames * 2);
+        return frames;
+    }
+
+    // The resampler works on float copies of the raw DAC values, the result goes through the same kernels
+    for (uint32_t i = 0; i < frames * 2; i++)
+    {
+        render->resample_in[i] = (float)raw[i];
+    }
+    ma_uint64 in_frames = frames;
+    ma_uint64 out_frames = render->max_out_frames;
+    ma_resampler_process_pcm_frames(&render->resampler, render->resample_in, &in_frames, render->resample_out,
+                                    &out_frames);
+    for (ma_uint64 i = 0; i < out_frames * 2; i++)
+    {
+        render->resampled[i] = (int32_t)lrintf(render->resample_out[i]);
+    }
+    convert_samples(render->format, render->resampled, out, (size_t)out_frames * 2);
+    return (size_t)out_frames;
+}
+
+static int render_block_silent(const uint8_t *data, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+    {
+        if (data[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Append the stem section of an encoded block to the stem files
+static void render_write_stems(OfflineRender *render, const uint8_t *section)
+{
+    static const uint8_t silence[RENDER_BLOCK_FRAMES * 2 * 4] = {0};
+    size_t bytes_per_frame = 2 * sample_format_bytes(render->format);
+    size_t frames;
+    memcpy(&frames, section, sizeof(size_t));
+    for (int ch = 0; ch < STEM_CHANNELS && !render->stems_failed; ch++)
+    {
+        const uint8_t *block = section + sizeof(size_t) + (size_t)ch * RENDER_BLOCK_FRAMES * bytes_per_frame;
+        if (!render->stems[ch])
+        {
+            if (render_block_silent(block, frames * bytes_per_frame))
+            {
+                continue;
+            }
+            char filename[256];
+            snprintf(filename, sizeof(filename), "%s_ch%d.%s", render->stem_prefix, ch + 1,
+                     container_extension(render->container));
+            render->stems[ch] = audio_writer_open(filename, render->format, INTERNAL_SAMPLE_RATE, render->container,
+                                                  render->expected_frames);
+            if (!render->stems[ch])
+            {
+                render->stems_failed = 1;
+                break;
+            }
+            for (uint64_t done = 0; done < render->stem_frames; done += RENDER_BLOCK_FRAMES)
+            {
+                uint64_t count = render->stem_frames - done;
+                audio_writer_write(render->stems[ch], silence,
+                                   count < RENDER_BLOCK_FRAMES ? (size_t)count : RENDER_BLOCK_FRAMES);
+            }
+        }
+        audio_writer_write(render->stems[ch], block, frames);
+    }
+    render->stem_frames += frames;
+}
+
+// Stage 3: append converted frames to the file (or queue them for the FLAC encoder)
+static void render_write(OfflineRender *render, const uint8_t *data, size_t frames)
+{
+    audio_writer_write(render->output, data, frames);
+    if (render->stem_prefix)
+    {
+        render_write_stems(render, data + render->stem_offset);
+    }
+}
+
+static ma_thread_result MA_THREADCALL render_emulate_thread(void *user_data)
+{
+    OfflineRender *render = (OfflineRender *)user_data;
+    for (;;)
+    {
+        int32_t *raw = (int32_t *)render_queue_begin_write(&render->raw_queue);
+        double start = render_now_ms();
+        uint32_t frames = render_emulate(render, raw);
+        render->stage_ms[0] += render_now_ms() - start;
+        if (frames == 0)
+        {
+            break;
+        }
+        render_queue_end_write(&render->raw_queue, frames);
+    }
+    render_queue_finish(&render->raw_queue);
+    return (ma_thread_result)0;
+}
+
+static ma_thread_result MA_THREADCALL render_convert_thread(void *user_data)
+{
+    OfflineRender *render = (OfflineRender *)user_data;
+    size_t frames;
+    const int32_t *raw;
+    while ((raw = (const int32_t *)render_queue_begin_read(&render->raw_queue, &frames)) != NULL)
+    {
+        uint8_t *out = (uint8_t *)render_queue_begin_write(&render->encoded_queue);
+        double start = render_now_ms();
+        size_t out_frames = render_convert(render, raw, (uint32_t)frames, out);
+        render->stage_ms[1] += render_now_ms() - start;
+        render_queue_end_read(&render->raw_queue);
+        render_queue_end_write(&render->encoded_queue, out_frames);
+    }
+    render_queue_finish(&render->encoded_queue);
+    return (ma_thread_result)0;
+}
+
+static void render_sequential(OfflineRender *render)
+{
+    uint32_t frames;
+    for (;;)
+    {
+        double t0 = render_now_ms();
+        frames = render_emulate(render, render->raw);
+        double t1 = render_now_ms();
+        if (frames == 0)
+        {
+            render->stage_ms[0] += t1 - t0;
+            break;
+        }
+        size_t out_frames = render_convert(render, render->raw, frames, render->encoded);
+        double t2 = render_now_ms();
+        render_write(render, render->encoded, out_frames);
+        double t3 = render_now_ms();
+        render->stage_ms[0] += t1 - t0;
+        render->stage_ms[1] += t2 - t1;
+        render->stage_ms[2] += t3 - t2;
+    }
+}
+
+static int render_pipelined(OfflineRender *render)
+{
+    ma_thread emulate_thread, convert_thread;
+    if (ma_thread_create(&convert_thread, ma_thread_priority_normal, 0, render_convert_thread, render, NULL) !=
+        MA_SUCCESS)
+    {
+        fprintf(stderr, "❌ Failed to start conversion thread\n");
+        return 0;
+    }
+    if (ma_thread_create(&emulate_thread, ma_thread_priority_highest, 0, render_emulate_thread, render, NULL) !=
+        MA_SUCCESS)
+    {
+        fprintf(stderr, "❌ Failed to start emulation thread\n");
+        render_queue_finish(&render->raw_queue); // Lets the conversion thread finish
+        ma_thread_wait(&convert_thread);
+        return 0;
+    }
+
+    size_t frames;
+    const uint8_t *data;
+    while ((data = (const uint8_t *)render_queue_begin_read(&render->encoded_queue, &frames)) != NULL)
+    {
+        double start = render_now_ms();
+        render_write(render, data, frames);
+        render->stage_ms[2] += render_now_ms() - start;
+        render_queue_end_read(&render->encoded_queue);
+    }
+
+    ma_thread_wait(&convert_thread);
+    ma_thread_wait(&emulate_thread);
+    return 1;
+}
+
+static void free_offline_render(OfflineRender *render)
+{
+    free(render->raw);
+    free(render->encoded);
+    free(render->resample_in);
+    free(render->resample_out);
+    free(render->resampled);
+    free(render->stem_channel);
+    render_queue_free(&render->raw_queue);
+    render_queue_free(&render->encoded_queue);
+    if (render->resample)
+    {
+        ma_resampler_uninit(&render->resampler, NULL);
+    }
+}
+
+// Close the stem files, returns 0 if one could not be written
+static int close_render_stems(OfflineRender *render)
+{
+    int ok = !render->stems_failed;
+    int saved = 0;
+    for (int ch = 0; ch < STEM_CHANNELS; ch++)
+    {
+        if (render->stems[ch])
+        {
+            char filename[256];
+            snprintf(filename, sizeof(filename), "%s_ch%d.%s", render->stem_prefix, ch + 1,
+                     container_extension(render->container));
+            ok = audio_writer_close(render->stems[ch], filename) && ok;
+            saved++;
+        }
+    }
+    if (ok)
+    {
+        printf("✅ Saved %d channel stems (%d silent channels skipped)\n", saved, STEM_CHANNELS - saved);
+    }
+    return ok;
+}
+
+// Render ctx from its current position to total_samples (and the rest of a playlist) into a WAV, RF64, W64
+// or FLAC file (output_rate 0 = internal rate), with one file per non-silent channel if stem_prefix is set
+// (the chip must capture stems then)
+int offline_render(AudioContext *ctx, const char *filename, RenderMode mode, SampleFormat format, uint32_t output_rate,
+                   AudioContainer container, const char *stem_prefix)
+{
+    OfflineRender render;
+    memset(&render, 0, sizeof(OfflineRender));
+    render.ctx = ctx;
+    render.format = format;
+    render.container = container;
+    render.stem_prefix = stem_prefix;
+    render.expected_frames = render_expected_samples(ctx);
+    render.output_rate = output_rate ? output_rate : INTERNAL_SAMPLE_RATE;
+    render.resample = render.output_rate != INTERNAL_SAMPLE_RATE;
+    render.max_out_frames = RENDER_BLOCK_FRAMES;
+
+    size_t raw_bytes = RENDER_BLOCK_FRAMES * (stem_prefix ? 2 + STEM_VALUES_PER_FRAME : 2) * sizeof(int32_t);
+    if (render.resample)
+    {
+        ma_resampler_config config = ma_resampler_config_init(ma_format_f32, 2, INTERNAL_SAMPLE_RATE,
+                                                              render.output_rate, ma_resample_algorithm_linear);
+        if (ma_resampler_init(&config, NULL, &render.resampler) != MA_SUCCESS)
+        {
+            fprintf(stderr, "❌ Failed to initialize resampler\n");
+            return 0;
+        }
+        render.max_out_frames = (size_t)((uint64_t)RENDER_BLOCK_FRAMES * render.output_rate / INTERNAL_SAMPLE_RATE) + 4;
+        render.resample_in = (float *)malloc(RENDER_BLOCK_FRAMES * 2 * sizeof(float));
+        render.resample_out = (float *)malloc(render.max_out_frames * 2 * sizeof(float));
+        render.resampled = (int32_t *)malloc(render.max_out_frames * 2 * sizeof(int32_t));
+    }
+    size_t encoded_bytes = render.max_out_frames * 2 * sample_format_bytes(format);
+    if (stem_prefix)
+    {
+        render.stem_offset = (encoded_bytes + 7) & ~(size_t)7;
+        encoded_bytes = render.stem_offset + sizeof(size_t) +
+                        (size_t)STEM_CHANNELS * RENDER_BLOCK_FRAMES * 2 * sample_format_bytes(format);
+        render.stem_channel = (int32_t *)malloc(RENDER_BLOCK_FRAMES * 2 * sizeof(int32_t));
+    }
+
+    int ok = !render.resample || (render.resample_in && render.resample_out && render.resampled);
+    ok = ok && (!stem_prefix || render.stem_channel);
+    if (mode == RENDER_PIPELINED)
+    {
+        ok = ok && render_queue_init(&render.raw_queue, raw_bytes) &&
+             render_queue_init(&render.encoded_queue, encoded_bytes);
+    }
+    else
+    {
+        render.raw = (int32_t *)malloc(raw_bytes);
+        render.encoded = (uint8_t *)malloc(encoded_bytes);
+        ok = ok && render.raw && render.encoded;
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "❌ Failed to allocate render buffers\n");
+        free_offline_render(&render);
+        return 0;
+    }
+
+    uint64_t expected_output = render.expected_frames * render.output_rate / INTERNAL_SAMPLE_RATE;
+    render.output = audio_writer_open(filename, format, render.output_rate, container,
+                                      render.expected_frames ? expected_output + 4 : 0);
+    if (!render.output)
+    {
+        free_offline_render(&render);
+        return 0;
+    }
+
+    printf("Rendering %s (%s %s, %u Hz)...\n", mode == RENDER_PIPELINED ? "pipelined" : "sequential",
+           sample_format_name(format), container_extension(container), render.output_rate);
+    uint64_t first_sample = playback_elapsed_samples(ctx);
+    double start = render_now_ms();
+    if (mode == RENDER_PIPELINED)
+    {
+        ok = render_pipelined(&render);
+    }
+    else
+    {
+        render_sequential(&render);
+    }
+    double elapsed_ms = render_now_ms() - start;
+
+    // FLAC: waits for the encoder threads to catch up (the files are complete only then)
+    double flush_start = render_now_ms();
+    ok = audio_writer_close(render.output, filename) && ok;
+    if (stem_prefix)
+    {
+        ok = close_render_stems(&render) && ok;
+    }
+    elapsed_ms += render_now_ms() - flush_start;
+
+    double audio_ms = (double)(playback_elapsed_samples(ctx) - first_sample) * 1000.0 / INTERNAL_SAMPLE_RATE;
+    printf("Offline render statistics:\n");
+    printf("  Rendered %.2f s of audio in %.1f ms (%.1fx real time)\n", audio_ms / 1000.0, elapsed_ms,
+           elapsed_ms > 0 ? audio_ms / elapsed_ms : 0.0);
+    printf("  Stage busy time: emulate %.1f ms, resample+convert %.1f ms, write %.1f ms\n", render.stage_ms[0],
+           render.stage_ms[1], render.stage_ms[2]);
+    printf("  Emulation share of wall time: %.1f%%\n", elapsed_ms > 0 ? render.stage_ms[0] * 100.0 / elapsed_ms : 0.0);
+    if (mode == RENDER_PIPELINED)
+    {
+        // Emulation waiting on a full queue means a later stage is the bottleneck
+        printf("  Queue waits: emulate blocked %llu, convert starved %llu / blocked %llu, write starved %llu\n",
+               (unsigned long long)render.raw_queue.producer_waits, (unsigned long long)render.raw_queue.consumer_waits,
+               (unsigned long long)render.encoded_queue.producer_waits,
+               (unsigned long long)render.encoded_queue.consumer_waits);
+    }
+    free_offline_render(&render);
+    return ok;
+}
+
+#endif // OFFLINE_RENDER_H
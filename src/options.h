@@ -0,0 +1,316 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "channel_control.h"
+#include "event_cache.h"
+#include "live_input.h"
+#include "offline_render.h"
+#include "playlist.h"
+#include "sample_convert.h"
+#include "wav_writer.h"
+
+// Command line options for the player
+
+typedef struct
+{
+    const char *json_filename;  // First log file
+    const char *json_filenames[PLAYLIST_MAX_SONGS]; // All log files (more than one = gapless playlist)
+    int json_count;
+    SampleFormat sample_format; // WAV file and live output format
+    AudioContainer container;   // output.wav, output.w64 or output.flac
+    int compact_events;         // Keep events as compact delta-encoded stream instead of pass2 array
+    int optimize_writes;        // Drop register writes that restate the current value
+    int busy_write_timing;      // Issue writes paced by the busy flag instead of fixed DELAY_SAMPLES spacing
+    int strobe_capture;         // Emit one sample per DAC latch instead of CYCLES_PER_SAMPLE clocks
+    int stems;                  // Also write one WAV file per FM channel
+    uint8_t mute_mask;          // Channels muted at start (bit n = channel n+1, see channel_control.h)
+    RenderMode render_mode;     // Real-time playback or offline render to output.wav (see offline_render.h)
+    uint32_t output_rate;       // Offline render sample rate (0 = INTERNAL_SAMPLE_RATE)
+    const char *live_source;    // Streaming input: "-" for stdin or a UNIX socket path (NULL = JSON file)
+    LiveInputFormat live_format;
+    double lookahead_ms;        // Scheduling delay for untimed live events (0 = one device period)
+    uint32_t loops;             // Passes through the loop body of a looped log (0 = LOOP_FOREVER)
+    double duration;            // Playback time limit in seconds (0 = no limit)
+    int no_wav;                 // Play without recording output.wav (no WAV buffer)
+    int cache;                  // Use and write the .pass2cache sidecar of each log (opt-in)
+} PlayerOptions;
+
+void print_usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [options] <json_log_file>...\n", program);
+    fprintf(stderr, "       %s [options] --live <-|socket_path>\n", program);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --format <s16|s16clip|s24|f32>  Output sample format (default: s16)\n");
+    fprintf(stderr, "  --container <wav|rf64|w64|flac> Save output.wav (RF64 past 4 GB), RF64 output.wav, Wave64 output.w64\n");
+    fprintf(stderr, "                                  or lossless compressed output.flac (default: wav)\n");
+    fprintf(stderr, "  --compact-events                Store events as compact delta stream (less memory)\n");
+    fprintf(stderr, "  --optimize-writes               Remove redundant register writes before playback\n");
+    fprintf(stderr, "  --write-timing <fixed|busy>     Fixed write spacing or busy-flag scheduling (default: fixed)\n");
+    fprintf(stderr, "  --capture <fixed|strobe>        %d clocks per sample or one sample per DAC latch (default: fixed)\n",
+            CYCLES_PER_SAMPLE);
+    fprintf(stderr, "  --stems                         Also save each FM channel as output_chN.wav\n");
+    fprintf(stderr, "  --mute <channels>               Mute channels at start, e.g. 1,3 or 5-8\n");
+    fprintf(stderr, "  --solo <channels>               Play only these channels at start\n");
+    fprintf(stderr, "  --render <sequential|pipelined> Render to output.wav without an audio device\n");
+    fprintf(stderr, "  --rate <hz>                     Offline render sample rate (default: %d)\n", INTERNAL_SAMPLE_RATE);
+    fprintf(stderr, "  --live <-|socket_path>          Read register writes from stdin or a UNIX socket\n");
+    fprintf(stderr, "  --live-format <jsonl|binary>    Live record format (default: jsonl)\n");
+    fprintf(stderr, "  --lookahead <ms>                Delay for live events without time (default: one buffer)\n");
+    fprintf(stderr, "  --loops <n>                     Play the loop body of a looped log n times (default: endless,\n");
+    fprintf(stderr, "                                  %d in a playlist)\n", PLAYLIST_DEFAULT_LOOPS);
+    fprintf(stderr, "  --duration <seconds>            Stop playback (each log of a playlist) after this time\n");
+    fprintf(stderr, "  --no-wav                        Don't record output.wav (constant memory for long sessions)\n");
+    fprintf(stderr, "  --cache                         Keep parsed logs in <log>%s next to each log and map\n",
+            EVENT_CACHE_SUFFIX);
+    fprintf(stderr, "                                  them on later runs instead of parsing\n");
+    fprintf(stderr, "Several log files are played back to back without a gap (the next one loads while playing).\n");
+    fprintf(stderr, "Example: %s events.json\n", program);
+}
+
+// Parse command line, returns 0 on error (usage is printed)
+int parse_player_options(int argc, char **argv, PlayerOptions *options)
+{
+    memset(options, 0, sizeof(PlayerOptions));
+    options->sample_format = SAMPLE_FORMAT_S16;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--format") == 0 && i + 1 < argc)
+        {
+            if (!parse_sample_format(argv[++i], &options->sample_format))
+            {
+                fprintf(stderr, "❌ Unknown sample format: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--container") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            if (strcmp(name, "wav") == 0)
+            {
+                options->container = CONTAINER_WAV;
+            }
+            else if (strcmp(name, "rf64") == 0)
+            {
+                options->container = CONTAINER_RF64;
+            }
+            else if (strcmp(name, "w64") == 0)
+            {
+                options->container = CONTAINER_W64;
+            }
+            else if (strcmp(name, "flac") == 0)
+            {
+                options->container = CONTAINER_FLAC;
+            }
+            else
+            {
+                fprintf(stderr, "❌ Unknown container: %s\n", name);
+                print_usage(argv[0]);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--compact-events") == 0)
+        {
+            options->compact_events = 1;
+        }
+        else if (strcmp(arg, "--optimize-writes") == 0)
+        {
+            options->optimize_writes = 1;
+        }
+        else if (strcmp(arg, "--stems") == 0)
+        {
+            options->stems = 1;
+        }
+        else if ((strcmp(arg, "--mute") == 0 || strcmp(arg, "--solo") == 0) && i + 1 < argc)
+        {
+            uint8_t channels;
+            if (!parse_channel_list(argv[++i], &channels))
+            {
+                fprintf(stderr, "❌ Invalid channel list: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 0;
+            }
+            options->mute_mask |= strcmp(arg, "--mute") == 0 ? channels : (uint8_t)(CHANNEL_MASK_ALL & ~channels);
+        }
+        else if (strcmp(arg, "--render") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            if (strcmp(name, "sequential") == 0)
+            {
+                options->render_mode = RENDER_SEQUENTIAL;
+            }
+            else if (strcmp(name, "pipelined") == 0)
+            {
+                options->render_mode = RENDER_PIPELINED;
+            }
+            else
+            {
+                fprintf(stderr, "❌ Unknown render mode: %s\n", name);
+                print_usage(argv[0]);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--rate") == 0 && i + 1 < argc)
+        {
+            int rate = atoi(argv[++i]);
+            if (rate < 8000 || rate > 384000)
+            {
+                fprintf(stderr, "❌ Invalid sample rate: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 0;
+            }
+            options->output_rate = (uint32_t)rate;
+        }
+        else if (strcmp(arg, "--capture") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            if (strcmp(name, "fixed") == 0 || strcmp(name, "strobe") == 0)
+            {
+                options->strobe_capture = strcmp(name, "strobe") == 0;
+            }
+            else
+            {
+                fprintf(stderr, "❌ Unknown capture mode: %s\n", name);
+                print_usage(argv[0]);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--write-timing") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            if (strcmp(name, "fixed") == 0 || strcmp(name, "busy") == 0)
+            {
+                options->busy_write_timing = strcmp(name, "busy") == 0;
+            }
+            else
+            {
+                fprintf(stderr, "❌ Unknown write timing: %s\n", name);
+                print_usage(argv[0]);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--live") == 0 && i + 1 < argc)
+        {
+            options->live_source = argv[++i];
+        }
+        else if (strcmp(arg, "--live-format") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            if (strcmp(name, "jsonl") == 0)
+            {
+                options->live_format = LIVE_INPUT_JSONL;
+            }
+            else if (strcmp(name, "binary") == 0)
+            {
+                options->live_format = LIVE_INPUT_BINARY;
+            }
+            else
+            {
+                fprintf(stderr, "❌ Unknown live input format: %s\n", name);
+                print_usage(argv[0]);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--lookahead") == 0 && i + 1 < argc)
+        {
+            options->lookahead_ms = atof(argv[++i]);
+            if (options->lookahead_ms < 0)
+            {
+                fprintf(stderr, "❌ Invalid lookahead: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--loops") == 0 && i + 1 < argc)
+        {
+            int loops = atoi(argv[++i]);
+            if (loops < 1)
+            {
+                fprintf(stderr, "❌ Invalid loop count: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 0;
+            }
+            options->loops = (uint32_t)loops;
+        }
+        else if (strcmp(arg, "--duration") == 0 && i + 1 < argc)
+        {
+            options->duration = atof(argv[++i]);
+            if (options->duration <= 0)
+            {
+                fprintf(stderr, "❌ Invalid duration: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--no-wav") == 0)
+        {
+            options->no_wav = 1;
+        }
+        else if (strcmp(arg, "--cache") == 0)
+        {
+            options->cache = 1;
+        }
+        else if (arg[0] == '-' && arg[1] == '-')
+        {
+            fprintf(stderr, "❌ Unknown option: %s\n", arg);
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (options->json_count == PLAYLIST_MAX_SONGS)
+        {
+            fprintf(stderr, "❌ Too many log files (at most %d)\n", PLAYLIST_MAX_SONGS);
+            return 0;
+        }
+        else
+        {
+            options->json_filenames[options->json_count++] = arg;
+        }
+    }
+    options->json_filename = options->json_count ? options->json_filenames[0] : NULL;
+
+    if (!options->json_filename && !options->live_source)
+    {
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (options->busy_write_timing && (options->compact_events || options->live_source))
+    {
+        fprintf(stderr, "❌ --write-timing busy can't be combined with --compact-events or --live\n");
+        return 0;
+    }
+    if ((options->stems || options->render_mode != RENDER_REALTIME) && options->live_source)
+    {
+        fprintf(stderr, "❌ --stems and --render can't be combined with --live\n");
+        return 0;
+    }
+    if (options->output_rate && options->render_mode == RENDER_REALTIME)
+    {
+        fprintf(stderr, "❌ --rate requires --render\n");
+        return 0;
+    }
+    if ((options->loops || options->duration > 0) && options->live_source)
+    {
+        fprintf(stderr, "❌ --loops and --duration can't be combined with --live\n");
+        return 0;
+    }
+    if (options->json_count > 1 && (options->live_source || options->busy_write_timing || options->stems))
+    {
+        fprintf(stderr, "❌ A playlist can't be combined with --live, --write-timing busy or --stems\n");
+        return 0;
+    }
+    if (options->container == CONTAINER_FLAC && options->sample_format == SAMPLE_FORMAT_F32)
+    {
+        fprintf(stderr, "❌ FLAC stores integer samples: use --format s16, s16clip or s24\n");
+        return 0;
+    }
+    if (options->no_wav && (options->stems || options->render_mode != RENDER_REALTIME))
+    {
+        fprintf(stderr, "❌ --no-wav can't be combined with --stems or --render\n");
+        return 0;
+    }
+    return 1;
+}
+
+#endif // OPTIONS_H
@@ -0,0 +1,161 @@
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include "audio_context.h"
+#include "channel_control.h"
+#include "core.h"
+#include "latency_stats.h"
+#include "live_input.h"
+#include "playlist.h"
+#include "sample_convert.h"
+
+// Real-time playback front end: audio device callback
+// Not part of headless builds (YM2151_HEADLESS leaves out miniaudio's device backends).
+
+// MiniAudio data callback
+void data_callback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uint32 frameCount)
+{
+    AudioContext *pContext = (AudioContext *)pDevice->pUserData;
+    ma_uint32 bytesPerFrame = ma_get_bytes_per_frame(pContext->device_format, 2);
+
+    (void)pInput;
+
+    // Start timing measurement
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    if (!ma_atomic_bool32_get(&pContext->is_playing))
+    {
+        memset(pOutput, 0, frameCount * bytesPerFrame);
+        return;
+    }
+
+    if (pContext->live)
+    {
+        live_input_begin_callback(pContext->live, &start_time, pContext->samples_played);
+    }
+
+    // Calculate required input frames
+    ma_uint64 requiredInputFrames = 0;
+    ma_result result = ma_resampler_get_required_input_frame_count(&pContext->resampler, frameCount, &requiredInputFrames);
+    if (result != MA_SUCCESS)
+    {
+        memset(pOutput, 0, frameCount * bytesPerFrame);
+        return;
+    }
+
+    if (requiredInputFrames > INTERNAL_BUFFER_SIZE)
+    {
+        requiredInputFrames = INTERNAL_BUFFER_SIZE;
+    }
+
+    // Mute/solo changes take effect at buffer boundaries
+    if (pContext->channels)
+    {
+        OPM_SetMuteMask(&pContext->chip, (uint8_t)ma_atomic_uint32_get(&pContext->channels->mute_mask));
+    }
+
+    // Generate internal samples
+    ma_uint64 actualInputFrames = 0;
+    for (ma_uint64 i = 0; i < requiredInputFrames; i++)
+    {
+        // Playlist: the next log starts at the next sample of the same buffer
+        if (pContext->samples_played >= pContext->total_samples && pContext->playlist)
+        {
+            PlaylistStep step = playlist_next_song(pContext, 0);
+            if (step == PLAYLIST_LOADING)
+            {
+                // Not loaded in time: play silence and try again in the next buffer
+                memset(&pContext->raw_buffer[i * 2], 0, (size_t)(requiredInputFrames - i) * 2 * sizeof(int32_t));
+                pContext->playlist->gap_samples += requiredInputFrames - i;
+                actualInputFrames = requiredInputFrames;
+                break;
+            }
+        }
+
+        if (pContext->samples_played >= pContext->total_samples)
+        {
+            // Fill rest with silence
+            for (ma_uint64 j = i; j < requiredInputFrames; j++)
+            {
+                pContext->raw_buffer[j * 2] = 0;
+                pContext->raw_buffer[j * 2 + 1] = 0;
+            }
+            actualInputFrames = requiredInputFrames;
+            ma_atomic_bool32_set(&pContext->is_playing, MA_FALSE);
+            ma_event_signal(&pContext->playback_done); // Wake up main thread
+            break;
+        }
+
+        // Generate one stereo sample
+        int32_t output[2] = {0, 0};
+        generate_sample(pContext, output);
+
+        // Store raw DAC output (converted to the device format below)
+        pContext->raw_buffer[i * 2] = output[0];
+        pContext->raw_buffer[i * 2 + 1] = output[1];
+
+        // Also store to WAV buffer (keep as 32-bit)
+        if (pContext->wav_buffer && pContext->wav_buffer_pos < pContext->wav_buffer_capacity)
+        {
+            pContext->wav_buffer[pContext->wav_buffer_pos * 2] = output[0];
+            pContext->wav_buffer[pContext->wav_buffer_pos * 2 + 1] = output[1];
+            if (pContext->stem_buffer)
+            {
+                OPM_GetStems(&pContext->chip, &pContext->stem_buffer[pContext->wav_buffer_pos * STEM_VALUES_PER_FRAME]);
+            }
+            pContext->wav_buffer_pos++;
+        }
+
+        pContext->samples_played++;
+    }
+
+    if (actualInputFrames == 0)
+    {
+        actualInputFrames = requiredInputFrames;
+    }
+
+    // Convert the whole block to the device format
+    const void *pInternal;
+    if (pContext->device_format == ma_format_f32)
+    {
+        convert_to_f32(pContext->raw_buffer, pContext->internal_buffer_f32, actualInputFrames * 2);
+        pInternal = pContext->internal_buffer_f32;
+    }
+    else
+    {
+        convert_samples(pContext->sample_format, pContext->raw_buffer, pContext->internal_buffer, actualInputFrames * 2);
+        pInternal = pContext->internal_buffer;
+    }
+
+    // Resample
+    ma_uint64 inputFramesProcessed = actualInputFrames;
+    ma_uint64 outputFramesProcessed = frameCount;
+    result = ma_resampler_process_pcm_frames(&pContext->resampler,
+                                             pInternal, &inputFramesProcessed,
+                                             pOutput, &outputFramesProcessed);
+
+    if (result != MA_SUCCESS)
+    {
+        memset(pOutput, 0, frameCount * bytesPerFrame);
+        return;
+    }
+
+    // Fill remaining with silence
+    if (outputFramesProcessed < frameCount)
+    {
+        memset((uint8_t *)pOutput + outputFramesProcessed * bytesPerFrame, 0,
+               (frameCount - outputFramesProcessed) * bytesPerFrame);
+    }
+    // End timing measurement
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double elapsed_ms = (end_time.tv_sec - start_time.tv_sec) * 1000.0 +
+                        (end_time.tv_nsec - start_time.tv_nsec) / 1000000.0;
+
+    // Update timing statistics
+    pContext->total_callback_time_ms += elapsed_ms;
+    pContext->callback_count++;
+    latency_stats_record(&pContext->latency, &start_time, &end_time);
+}
+
+#endif // PLAYBACK_H
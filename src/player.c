@@ -1,15 +1,76 @@
 /* YM2151 Log Player
  * Loads YM2151 register events from a JSON log file and plays them in real-time
  * Features:
- * - Load events from JSON log file
+ * - Load events from JSON log file (large logs are parsed on all cores)
  * - Real-time playback with WAV file output
+ * - Selectable output sample format (s16, s16clip, s24, f32)
+ * - Optional redundant register write elimination
+ * - Optional busy-flag paced register writes
+ * - Optional strobe capture (one sample per DAC latch)
+ * - Optional per-channel stems captured in the same render
+ * - Runtime channel mute/solo from the console
+ * - Offline rendering (sequential or pipelined) without an audio device
+ * - Live mode: stream register writes from stdin or a UNIX socket
+ * - Loop-point playback with loop count or duration limit
+ * - Gapless playlists: the next log is loaded in the background while playing
+ * - Optional sidecar cache of parsed logs (mapped instead of parsed on the next run)
+ * - FLAC output encoded on its own thread while rendering
+ * - Streaming WAV/RF64/W64 output: multi-hour renders past 4 GB in constant memory
  */
 
-#include "types.h"
-#include "events.h"
-#include "core.h"
-#include "wav_writer.h"
-#include "json_loader.h"
+#include "options.h"
+#include "playback.h"
+
+// Print busy-flag scheduler statistics and save the writes it issued
+static void report_write_scheduler(WriteScheduler *scheduler, const char *pass2_filename)
+{
+    print_write_scheduler_stats(scheduler);
+    printf("\n");
+
+    // Pass2 times were decided during playback
+    if (!save_events_json(pass2_filename, scheduler->issued))
+    {
+        fprintf(stderr, "❌ Failed to save pass2 events to %s\n", pass2_filename);
+    }
+    printf("\n");
+}
+
+// Print how often a looped log wrapped
+static void print_loop_stats(const AudioContext *context)
+{
+    if (context->loop && !context->playlist)
+    {
+        printf("Loop: %llu wraps, %.3f s played\n\n", (unsigned long long)context->loop->wraps,
+               (double)playback_elapsed_samples(context) / INTERNAL_SAMPLE_RATE);
+    }
+}
+
+// Release whichever event source was loaded
+static void free_loaded_events(Playlist *playlist, LiveInput *live, WriteScheduler *scheduler, RegisterEventList *pass1,
+                               EventStream *stream, RegisterEventList *events)
+{
+    if (playlist)
+    {
+        playlist_close(playlist);
+    }
+    else if (live)
+    {
+        live_input_close(live);
+    }
+    else if (scheduler)
+    {
+        free_write_scheduler(scheduler);
+        free_event_list(pass1);
+    }
+    else if (stream)
+    {
+        free_event_stream(stream);
+    }
+    else
+    {
+        free_event_list(events);
+    }
+}
 
 int main(int argc, char **argv)
 {
@@ -17,18 +78,73 @@ int main(int argc, char **argv)
     printf("=====================================\n\n");
 
     // Check command line arguments
-    if (argc < 2)
+    PlayerOptions options;
+    if (!parse_player_options(argc, argv, &options))
     {
-        fprintf(stderr, "Usage: %s <json_log_file>\n", argv[0]);
-        fprintf(stderr, "Example: %s events.json\n", argv[0]);
         return 1;
     }
 
-    const char *json_filename = argv[1];
+    const char *json_filename = options.json_filename;
 
-    // Load events from JSON file
-    RegisterEventList *events = load_events_json(json_filename);
-    if (!events)
+    // Load events from JSON file (pass2 array, or compact stream encoded from pass1), or open live input
+    RegisterEventList *events = NULL;
+    EventStream *stream = NULL;
+    LiveInput *live = NULL;
+    RegisterEventList *pass1 = NULL; // Kept for the write scheduler
+    WriteScheduler *scheduler = NULL;
+    Playlist *playlist = NULL;
+    if (options.json_count > 1)
+    {
+        // Songs are loaded by the playlist (the first one now, the others while playing)
+        playlist = playlist_open(options.json_filenames, options.json_count, options.compact_events,
+                                 options.optimize_writes, options.cache, options.loops,
+                                 (uint64_t)(options.duration * INTERNAL_SAMPLE_RATE));
+        if (!playlist)
+        {
+            fprintf(stderr, "❌ No log of the playlist could be loaded\n");
+            return 1;
+        }
+    }
+    else if (options.live_source)
+    {
+        live = live_input_open(options.live_source, options.live_format);
+        if (!live)
+        {
+            return 1;
+        }
+    }
+    else if (options.compact_events || options.optimize_writes || options.busy_write_timing)
+    {
+        pass1 = load_events_json_pass1(json_filename);
+        if (pass1 && options.optimize_writes)
+        {
+            RegisterEventList *optimized = optimize_redundant_writes(pass1);
+            free_event_list(pass1);
+            pass1 = optimized;
+        }
+        if (pass1 && options.busy_write_timing)
+        {
+            scheduler = create_write_scheduler(pass1);
+        }
+        else if (pass1)
+        {
+            if (options.compact_events)
+            {
+                stream = encode_event_stream(pass1);
+            }
+            else
+            {
+                events = convert_to_pass2_format(pass1);
+            }
+            free_event_list(pass1);
+            pass1 = NULL;
+        }
+    }
+    else
+    {
+        events = options.cache ? load_events_json_cached(json_filename) : load_events_json(json_filename);
+    }
+    if (!events && !stream && !live && !scheduler && !playlist)
     {
         fprintf(stderr, "❌ Failed to load events from %s\n", json_filename);
         return 1;
@@ -36,57 +152,221 @@ int main(int argc, char **argv)
 
     // Save pass2 format to JSON file
     const char *pass2_filename = "output_pass2.json";
-    if (!save_events_json(pass2_filename, events))
+    if (!live && !scheduler && !playlist &&
+        !(stream ? save_event_stream_json(pass2_filename, stream) : save_events_json(pass2_filename, events)))
     {
         fprintf(stderr, "❌ Failed to save pass2 events to %s\n", pass2_filename);
         // Continue execution even if save fails
     }
 
-    // Calculate playback duration
-    double duration = calculate_playback_duration(events);
+    // Calculate playback duration (live mode runs until the input is closed)
+    double duration;
+    if (live || playlist)
+    {
+        duration = LIVE_WAV_MAX_SECONDS;
+    }
+    else if (scheduler)
+    {
+        duration = pass1->count ? playback_duration_from_last_time(write_scheduler_last_time(scheduler)) : 1.0;
+    }
+    else if (stream)
+    {
+        duration = stream->count ? playback_duration_from_last_time(stream->last_sample_time) : 1.0;
+    }
+    else
+    {
+        duration = calculate_playback_duration(events);
+    }
     uint32_t total_samples = duration_to_samples(duration);
+    uint64_t duration_limit = (uint64_t)(options.duration * INTERNAL_SAMPLE_RATE);
+    if (duration_limit && duration_limit < total_samples && !playlist)
+    {
+        total_samples = (uint32_t)duration_limit;
+    }
+    uint32_t wav_capacity = total_samples;
+    if (live)
+    {
+        total_samples = UINT32_MAX; // Set by the audio callback at the end of the input
+    }
+
+    // Loop marker: repeat the loop body until the loop count or duration limit is reached
+    const LoopMarker *marker = live || playlist ? NULL : scheduler ? &pass1->loop : stream ? &stream->loop : &events->loop;
+    uint32_t loops = options.loops ? options.loops : LOOP_FOREVER;
+    LoopPlayback loop;
+    int looping = 0;
+    if (marker && marker->enabled && scheduler)
+    {
+        printf("⚠️  Loop marker ignored with --write-timing busy (playing once)\n\n");
+    }
+    else if (marker && marker->enabled)
+    {
+        looping = loop_playback_init(&loop, marker, events, stream, loops, duration_to_samples(duration),
+                                    duration_limit);
+        if (!looping)
+        {
+            printf("⚠️  Loop marker ignored: no events in the loop body\n\n");
+        }
+    }
+    else if (options.loops && !playlist)
+    {
+        printf("⚠️  --loops ignored: %s has no loop marker\n\n", json_filename);
+    }
+    if (looping)
+    {
+        if (loops == LOOP_FOREVER && !duration_limit && options.render_mode != RENDER_REALTIME)
+        {
+            fprintf(stderr, "❌ Endless loop: --render needs --loops or --duration\n");
+            free_loaded_events(playlist, live, scheduler, pass1, stream, events);
+            return 1;
+        }
+        print_loop_playback(&loop, loops);
+        total_samples = loop_playback_total_samples(&loop);
+
+        // Record the whole session, but an endless or very long one only up to LIVE_WAV_MAX_SECONDS
+        uint64_t length = loop_playback_length(&loop);
+        uint64_t max_capacity = (uint64_t)LIVE_WAV_MAX_SECONDS * INTERNAL_SAMPLE_RATE;
+        max_capacity = loop.song_end > max_capacity ? loop.song_end : max_capacity;
+        wav_capacity = (uint32_t)(length < max_capacity ? length : max_capacity);
+    }
+    if (options.no_wav)
+    {
+        wav_capacity = 0;
+    }
 
     // Initialize audio context
     AudioContext context;
     memset(&context, 0, sizeof(AudioContext));
-    context.min_callback_time_ms = DBL_MAX; // Initialize to maximum possible value
 
-    // Allocate WAV buffer
-    context.wav_buffer = (int32_t *)malloc(total_samples * 2 * sizeof(int32_t));
-    if (!context.wav_buffer)
+    // Allocate WAV buffer (offline rendering writes the file while rendering)
+    if (options.render_mode == RENDER_REALTIME && !options.no_wav)
     {
-        fprintf(stderr, "❌ Failed to allocate WAV buffer\n");
-        return 1;
+        context.wav_buffer = (int32_t *)malloc((size_t)wav_capacity * 2 * sizeof(int32_t));
+        if (!context.wav_buffer)
+        {
+            fprintf(stderr, "❌ Failed to allocate WAV buffer\n");
+            free_loaded_events(playlist, live, scheduler, pass1, stream, events);
+            return 1;
+        }
     }
     context.wav_buffer_pos = 0;
+    context.wav_buffer_capacity = wav_capacity;
+
+    // Stems share the WAV buffer position (8 stereo values per frame), offline rendering streams them to files
+    if (options.stems && options.render_mode != RENDER_REALTIME)
+    {
+        printf("Stems: streaming %d channels to output_ch*.%s\n\n", STEM_CHANNELS,
+               container_extension(options.container));
+    }
+    else if (options.stems)
+    {
+        context.stem_buffer = (int32_t *)malloc((size_t)wav_capacity * STEM_VALUES_PER_FRAME * sizeof(int32_t));
+        if (!context.stem_buffer)
+        {
+            fprintf(stderr, "❌ Failed to allocate stem buffer\n");
+            free(context.wav_buffer);
+            free_loaded_events(playlist, live, scheduler, pass1, stream, events);
+            return 1;
+        }
+        printf("Stems: capturing %d channels (%.1f MB)\n\n", STEM_CHANNELS,
+               (double)wav_capacity * STEM_VALUES_PER_FRAME * sizeof(int32_t) / (1024.0 * 1024.0));
+    }
 
     // Initialize OPM chip
     OPM_Reset(&context.chip);
+    OPM_SetStemCapture(&context.chip, options.stems);
+#ifdef OPM_PROFILE
+    OPM_ProfileReset(); // Exclude reset clocks from the profile
+#endif
 
     // Set playback parameters
     context.events = events;
     context.next_event_index = 0;
+    context.stream = stream;
+    if (stream)
+    {
+        event_stream_rewind(stream, &context.stream_cursor);
+    }
+    context.live = live;
+    context.scheduler = scheduler;
+    context.loop = looping ? &loop : NULL;
+    context.strobe_capture = (uint8_t)options.strobe_capture;
+    ChannelControl channels;
+    channel_control_init(&channels, options.mute_mask);
+    context.channels = &channels;
+    if (options.strobe_capture)
+    {
+        printf("Capture: one sample per DAC latch (sh1 strobe) instead of %d clocks\n\n", CYCLES_PER_SAMPLE);
+    }
     context.samples_played = 0;
     context.total_samples = total_samples;
-    context.is_playing = 1;
+    if (playlist)
+    {
+        playlist_begin(playlist, &context);
+    }
+    ma_atomic_bool32_set(&context.is_playing, MA_TRUE);
+
+    // Offline render: no audio device, output.wav (or .w64/.flac) is written block by block
+    char output_filename[32];
+    snprintf(output_filename, sizeof(output_filename), "output.%s", container_extension(options.container));
+    if (options.render_mode != RENDER_REALTIME)
+    {
+        OPM_SetMuteMask(&context.chip, options.mute_mask);
+        int ok = offline_render(&context, output_filename, options.render_mode, options.sample_format,
+                                options.output_rate, options.container, options.stems ? "output" : NULL);
+        print_loop_stats(&context);
+        if (playlist)
+        {
+            print_playlist_stats(&context);
+        }
+        if (scheduler)
+        {
+            report_write_scheduler(scheduler, pass2_filename);
+        }
+        free_loaded_events(playlist, live, scheduler, pass1, stream, events);
+        if (!ok)
+        {
+            return 1;
+        }
+        printf("\n✅ Render complete!\n");
+        return 0;
+    }
+
+    // 16-bit formats are played as s16, wider formats as f32 to keep the full DAC range
+    context.sample_format = options.sample_format;
+    context.device_format = (options.sample_format == SAMPLE_FORMAT_S24 || options.sample_format == SAMPLE_FORMAT_F32)
+                                ? ma_format_f32
+                                : ma_format_s16;
 
     printf("Initializing audio...\n");
 
+    // Initialize completion event (signaled by the audio callback)
+    if (ma_event_init(&context.playback_done) != MA_SUCCESS)
+    {
+        fprintf(stderr, "❌ Failed to initialize playback event\n");
+        free(context.wav_buffer);
+        free(context.stem_buffer);
+        free_loaded_events(playlist, live, scheduler, pass1, stream, events);
+        return 1;
+    }
+
     // Initialize resampler
     ma_resampler_config resamplerConfig = ma_resampler_config_init(
-        ma_format_s16, 2, INTERNAL_SAMPLE_RATE, OUTPUT_SAMPLE_RATE,
+        context.device_format, 2, INTERNAL_SAMPLE_RATE, OUTPUT_SAMPLE_RATE,
         ma_resample_algorithm_linear);
 
     if (ma_resampler_init(&resamplerConfig, NULL, &context.resampler) != MA_SUCCESS)
     {
         fprintf(stderr, "❌ Failed to initialize resampler\n");
+        ma_event_uninit(&context.playback_done);
         free(context.wav_buffer);
+        free(context.stem_buffer);
+        free_loaded_events(playlist, live, scheduler, pass1, stream, events);
         return 1;
     }
 
     // Configure MiniAudio device
     ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-    deviceConfig.playback.format = ma_format_s16;
+    deviceConfig.playback.format = context.device_format;
     deviceConfig.playback.channels = 2;
     deviceConfig.sampleRate = OUTPUT_SAMPLE_RATE;
     deviceConfig.dataCallback = data_callback;
@@ -97,7 +377,10 @@ int main(int argc, char **argv)
     {
         fprintf(stderr, "❌ Failed to initialize audio device\n");
         ma_resampler_uninit(&context.resampler, NULL);
+        ma_event_uninit(&context.playback_done);
         free(context.wav_buffer);
+        free(context.stem_buffer);
+        free_loaded_events(playlist, live, scheduler, pass1, stream, events);
         return 1;
     }
 
@@ -109,25 +392,56 @@ int main(int argc, char **argv)
     printf("Audio buffer size: %u frames\n", buffer_size_frames);
     printf("Buffer duration (processing time window): %.2f ms\n\n", buffer_duration_ms);
 
+    // Callbacks slower than one device period are counted as over budget
+    latency_stats_init(&context.latency, buffer_duration_ms);
+
+    // Untimed live events are scheduled this far ahead of their arrival (at least one buffer avoids late events)
+    if (live)
+    {
+        double lookahead_ms = options.lookahead_ms > 0 ? options.lookahead_ms : buffer_duration_ms;
+        live->lookahead_samples = (uint32_t)(lookahead_ms * INTERNAL_SAMPLE_RATE / 1000.0);
+        latency_stats_init(&live->input_latency, lookahead_ms);
+        printf("Live lookahead: %.2f ms (%u samples)\n\n", lookahead_ms, live->lookahead_samples);
+    }
+
     // Start playback
     if (ma_device_start(&device) != MA_SUCCESS)
     {
         fprintf(stderr, "❌ Failed to start audio device\n");
         ma_device_uninit(&device);
         ma_resampler_uninit(&context.resampler, NULL);
+        ma_event_uninit(&context.playback_done);
         free(context.wav_buffer);
+        free(context.stem_buffer);
+        free_loaded_events(playlist, live, scheduler, pass1, stream, events);
         return 1;
     }
 
-    printf("▶  Playing sequence...\n");
+    // Start reading live input (the callback plays silence until events arrive)
+    if (live && !live_input_start(live))
+    {
+        ma_atomic_bool32_set(&live->eof, MA_TRUE);
+    }
 
-    // Wait for playback to finish
-    while (context.is_playing)
+    // Read mute/solo commands from the console unless stdin carries the live input
+    int console_is_input = live && strcmp(options.live_source, "-") == 0;
+    if (!console_is_input)
     {
-        ma_sleep(100);
+        channel_control_start(&channels);
     }
 
+    printf("▶  Playing sequence...\n");
+
+    // Wait for playback to finish (no polling, the callback signals the event)
+    ma_event_wait(&context.playback_done);
+
+    channel_control_stop(&channels);
     printf("■  Playback complete\n\n");
+    print_loop_stats(&context);
+    if (playlist)
+    {
+        print_playlist_stats(&context);
+    }
 
     // Display timing statistics
     if (context.callback_count > 0)
@@ -136,33 +450,64 @@ int main(int argc, char **argv)
         printf("  Total callbacks: %lu\n", (unsigned long)context.callback_count);
         printf("  Average processing time: %.3f ms\n", 
                context.total_callback_time_ms / context.callback_count);
-        printf("  Minimum processing time: %.3f ms\n", context.min_callback_time_ms);
-        printf("  Maximum processing time: %.3f ms\n", context.max_callback_time_ms);
+        printf("  Maximum processing time: %.3f ms\n", context.latency.worst[0].duration_ns / 1000000.0);
         printf("  Buffer duration: %.2f ms\n", buffer_duration_ms);
         
         double avg_time = context.total_callback_time_ms / context.callback_count;
         double cpu_usage = (avg_time / buffer_duration_ms) * 100.0;
         printf("  CPU usage: %.1f%%\n", cpu_usage);
+        print_latency_stats(&context.latency);
         
-        if (context.max_callback_time_ms > buffer_duration_ms)
+        if (ma_atomic_uint64_get(&context.latency.over_budget) > 0)
         {
-            printf("  ⚠️  Warning: Maximum processing time (%.3f ms) exceeds buffer duration (%.2f ms)\n",
-                   context.max_callback_time_ms, buffer_duration_ms);
+            printf("  ⚠️  Warning: %llu callbacks exceeded buffer duration (%.2f ms)\n",
+                   (unsigned long long)ma_atomic_uint64_get(&context.latency.over_budget), buffer_duration_ms);
         }
+        save_latency_json("output_latency.json", &context.latency);
+        printf("\n");
+    }
+
+    if (live)
+    {
+        print_live_input_stats(live, buffer_duration_ms);
         printf("\n");
     }
+    if (scheduler)
+    {
+        report_write_scheduler(scheduler, pass2_filename);
+    }
+
+#ifdef OPM_PROFILE
+    OPM_ProfileDump("output_profile.json");
+    printf("\n");
+#endif
 
     // Stop and cleanup audio
     ma_device_uninit(&device);
     ma_resampler_uninit(&context.resampler, NULL);
+    ma_event_uninit(&context.playback_done);
 
-    // Save WAV file (hardcoded filename)
-    const char *wav_filename = "output.wav";
-    save_wav_file(wav_filename, context.wav_buffer, context.wav_buffer_pos);
+    // Save WAV or FLAC file (hardcoded filename)
+    if (context.wav_buffer)
+    {
+        if (playback_elapsed_samples(&context) > context.wav_buffer_capacity)
+        {
+            printf("⚠️  WAV output truncated to the first %.0f seconds\n",
+                   (double)context.wav_buffer_capacity / INTERNAL_SAMPLE_RATE);
+        }
+        save_audio_file(output_filename, context.wav_buffer, context.wav_buffer_pos, context.sample_format,
+                        options.container);
+    }
+    if (context.stem_buffer)
+    {
+        save_stem_files("output", context.stem_buffer, context.wav_buffer_pos, context.sample_format,
+                        options.container);
+    }
 
     // Cleanup
     free(context.wav_buffer);
-    free_event_list(events);
+    free(context.stem_buffer);
+    free_loaded_events(playlist, live, scheduler, pass1, stream, events);
 
     printf("\n✅ Playback complete!\n");
     return 0;
@@ -0,0 +1,322 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include "audio_context.h"
+#include "events.h"
+#include "event_cache.h"
+#include "event_optimizer.h"
+#include "event_stream.h"
+#include "json_loader.h"
+#include "loop_playback.h"
+
+// Gapless playlist playback
+// Several logs play back to back on one audio device (or into one offline render). A loader thread
+// loads and converts the next log while the current one plays and hands it over through two song
+// slots: when the current song ends, the audio callback switches to the prefetched song at that sample,
+// restarts the chip from a saved OPM_Reset state and keeps filling the same buffer. There is no gap,
+// and each song renders exactly as it would on its own. After the switch the loader frees the previous
+// song and prefetches the one after it. If a log is not loaded by the time the song before it ends, the
+// callback plays silence until it is (reported as gap).
+
+#define PLAYLIST_MAX_SONGS 256   // Log files on one command line
+#define PLAYLIST_DEFAULT_LOOPS 2 // Passes through a loop body without --loops (an endless loop would never advance)
+
+typedef enum
+{
+    PLAYLIST_SWITCHED = 0, // The next song is playing
+    PLAYLIST_LOADING,      // The next song is still being loaded
+    PLAYLIST_END           // No songs left
+} PlaylistStep;
+
+typedef struct
+{
+    RegisterEventList *events; // Pass2 events (NULL when the compact stream is used)
+    EventStream *stream;
+    uint32_t total_samples;    // Last event + 1 second, or the end of the last loop pass
+    LoopPlayback loop;
+    int looping;
+} PlaylistSong;
+
+typedef struct Playlist
+{
+    const char **filenames;
+    int count;
+    int compact_events;
+    int optimize_writes;
+    int use_cache;                // Pass2 arrays from the sidecar cache (see event_cache.h)
+    uint32_t loops;               // Passes through the loop body of looped logs
+    uint64_t duration_limit;      // Samples per song (0 = no limit)
+    opm_t reset_chip;             // Chip state after OPM_Reset, copied at the start of each song
+    PlaylistSong songs[2];        // Playing song and prefetched next song
+    int playing;                  // Slot of the playing song (written by the audio thread)
+    int playing_index;            // Playlist position of the playing song
+    int next_index;               // Playlist position of the prefetched song
+    ma_atomic_bool32 next_ready;  // Set by the loader when the other slot holds the next song
+    ma_atomic_bool32 loader_done; // Set by the loader after the last song was handed over
+    ma_atomic_bool32 stop;
+    ma_event wake;                // Signaled by the audio thread after a switch (and to stop the loader)
+    ma_event loaded;              // Signaled by the loader when it sets next_ready or loader_done
+    ma_thread thread;
+    int thread_started;
+    uint64_t finished_samples;    // Samples of the songs before the playing one
+    uint64_t gap_samples;         // Silence played while the next song was still loading
+    int songs_played;
+} Playlist;
+
+static void playlist_free_song(PlaylistSong *song)
+{
+    if (song->events)
+    {
+        free_event_list(song->events);
+    }
+    if (song->stream)
+    {
+        free_event_stream(song->stream);
+    }
+    memset(song, 0, sizeof(PlaylistSong));
+}
+
+// Load and convert one log (same steps as the player for a single log), returns 0 on failure
+static int playlist_load_song(Playlist *playlist, int index, PlaylistSong *song)
+{
+    double duration;
+    const LoopMarker *marker;
+    if (playlist->use_cache && !playlist->compact_events && !playlist->optimize_writes)
+    {
+        song->events = load_events_json_cached(playlist->filenames[index]);
+        if (!song->events)
+        {
+            return 0;
+        }
+        duration = calculate_playback_duration(song->events);
+        marker = &song->events->loop;
+    }
+    else
+    {
+        RegisterEventList *pass1 = load_events_json_pass1(playlist->filenames[index]);
+        if (!pass1)
+        {
+            return 0;
+        }
+        if (playlist->optimize_writes)
+        {
+            RegisterEventList *optimized = optimize_redundant_writes(pass1);
+            free_event_list(pass1);
+            pass1 = optimized;
+        }
+        if (playlist->compact_events)
+        {
+            song->stream = encode_event_stream(pass1);
+            duration = song->stream->count ? playback_duration_from_last_time(song->stream->last_sample_time) : 1.0;
+            marker = &song->stream->loop;
+        }
+        else
+        {
+            song->events = convert_to_pass2_format(pass1);
+            duration = calculate_playback_duration(song->events);
+            marker = &song->events->loop;
+        }
+        free_event_list(pass1);
+    }
+
+    song->total_samples = duration_to_samples(duration);
+    song->looping = marker->enabled && loop_playback_init(&song->loop, marker, song->events, song->stream,
+                                                          playlist->loops, song->total_samples,
+                                                          playlist->duration_limit);
+    if (song->looping)
+    {
+        song->total_samples = loop_playback_total_samples(&song->loop);
+    }
+    else if (playlist->duration_limit && playlist->duration_limit < song->total_samples)
+    {
+        song->total_samples = (uint32_t)playlist->duration_limit;
+    }
+    return 1;
+}
+
+static ma_thread_result MA_THREADCALL playlist_loader_thread(void *user_data)
+{
+    Playlist *playlist = (Playlist *)user_data;
+    for (int i = playlist->next_index + 1; i < playlist->count && !ma_atomic_bool32_get(&playlist->stop); i++)
+    {
+        // The other slot holds the song played before the current one (or nothing)
+        PlaylistSong *song = &playlist->songs[1 - playlist->playing];
+        playlist_free_song(song);
+        if (!playlist_load_song(playlist, i, song))
+        {
+            fprintf(stderr, "⚠️  Skipping %s\n", playlist->filenames[i]);
+            continue;
+        }
+        playlist->next_index = i;
+        ma_atomic_bool32_set(&playlist->next_ready, MA_TRUE); // Publish after the slot is filled
+        ma_event_signal(&playlist->loaded);
+
+        while (ma_atomic_bool32_get(&playlist->next_ready) && !ma_atomic_bool32_get(&playlist->stop))
+        {
+            ma_event_wait(&playlist->wake);
+        }
+        if (!ma_atomic_bool32_get(&playlist->stop))
+        {
+            printf("▶  Now playing %s (%d/%d)\n", playlist->filenames[i], i + 1, playlist->count);
+            fflush(stdout);
+        }
+    }
+    ma_atomic_bool32_set(&playlist->loader_done, MA_TRUE);
+    ma_event_signal(&playlist->loaded);
+    return (ma_thread_result)0;
+}
+
+// Load the first loadable log and start prefetching the next one, returns NULL if no log could be loaded
+// loops: passes through loop bodies (0 = PLAYLIST_DEFAULT_LOOPS), duration_limit: samples per song (0 = no limit)
+Playlist *playlist_open(const char **filenames, int count, int compact_events, int optimize_writes, int use_cache,
+                        uint32_t loops, uint64_t duration_limit)
+{
+    Playlist *playlist = (Playlist *)calloc(1, sizeof(Playlist));
+    if (!playlist)
+    {
+        fprintf(stderr, "❌ Failed to allocate playlist\n");
+        return NULL;
+    }
+    playlist->filenames = filenames;
+    playlist->count = count;
+    playlist->compact_events = compact_events;
+    playlist->optimize_writes = optimize_writes;
+    playlist->use_cache = use_cache;
+    playlist->loops = loops ? loops : PLAYLIST_DEFAULT_LOOPS;
+    playlist->duration_limit = duration_limit;
+    OPM_Reset(&playlist->reset_chip);
+
+    printf("Playlist: %d logs\n\n", count);
+    int first = 0;
+    while (first < count && !playlist_load_song(playlist, first, &playlist->songs[0]))
+    {
+        fprintf(stderr, "⚠️  Skipping %s\n", filenames[first]);
+        first++;
+    }
+    if (first == count)
+    {
+        free(playlist);
+        return NULL;
+    }
+    playlist->playing_index = first;
+    playlist->next_index = first;
+    printf("▶  Now playing %s (%d/%d)\n\n", filenames[first], first + 1, count);
+
+    int wake_ready = ma_event_init(&playlist->wake) == MA_SUCCESS;
+    int loaded_ready = ma_event_init(&playlist->loaded) == MA_SUCCESS;
+    if (!wake_ready || !loaded_ready ||
+        ma_thread_create(&playlist->thread, ma_thread_priority_normal, 0, playlist_loader_thread, playlist, NULL) !=
+            MA_SUCCESS)
+    {
+        fprintf(stderr, "❌ Failed to start the playlist loader\n");
+        if (wake_ready)
+        {
+            ma_event_uninit(&playlist->wake);
+        }
+        if (loaded_ready)
+        {
+            ma_event_uninit(&playlist->loaded);
+        }
+        playlist_free_song(&playlist->songs[0]);
+        free(playlist);
+        return NULL;
+    }
+    playlist->thread_started = 1;
+    return playlist;
+}
+
+// Samples played since the start, including earlier loop passes and playlist songs
+uint64_t playback_elapsed_samples(const AudioContext *ctx)
+{
+    return ctx->samples_played + (ctx->loop ? ctx->loop->wrapped_samples : 0) +
+           (ctx->playlist ? ctx->playlist->finished_samples : 0);
+}
+
+// Start the playing song: chip from the saved reset state (mute and stem settings kept), events from the start
+static void playlist_apply_song(AudioContext *ctx, PlaylistSong *song)
+{
+    uint8_t mute_mask = ctx->chip.mute_mask;
+    uint8_t stem_enable = ctx->chip.stem_enable;
+    ctx->chip = ctx->playlist->reset_chip;
+    OPM_SetMuteMask(&ctx->chip, mute_mask);
+    OPM_SetStemCapture(&ctx->chip, stem_enable);
+
+    ctx->events = song->events;
+    ctx->next_event_index = 0;
+    ctx->stream = song->stream;
+    if (song->stream)
+    {
+        event_stream_rewind(song->stream, &ctx->stream_cursor);
+    }
+    ctx->loop = song->looping ? &song->loop : NULL;
+    ctx->strobe_sh1 = 0;
+    ctx->samples_played = 0;
+    ctx->total_samples = song->total_samples;
+}
+
+// Set up ctx for the first song
+void playlist_begin(Playlist *playlist, AudioContext *ctx)
+{
+    ctx->playlist = playlist;
+    playlist_apply_song(ctx, &playlist->songs[playlist->playing]);
+}
+
+// Switch to the next song at the end of the current one (audio thread)
+// wait = 0 returns PLAYLIST_LOADING if the next song is not ready, wait = 1 blocks until it is (offline render)
+PlaylistStep playlist_next_song(AudioContext *ctx, int wait)
+{
+    Playlist *playlist = ctx->playlist;
+    while (!ma_atomic_bool32_get(&playlist->next_ready))
+    {
+        // The loader finishes only after the last song was handed over
+        if (ma_atomic_bool32_get(&playlist->loader_done))
+        {
+            return PLAYLIST_END;
+        }
+        if (!wait)
+        {
+            return PLAYLIST_LOADING;
+        }
+        ma_event_wait(&playlist->loaded); // The flags are checked again: a signal left from before is harmless
+    }
+
+    playlist->finished_samples = playback_elapsed_samples(ctx);
+    playlist->playing = 1 - playlist->playing;
+    playlist->playing_index = playlist->next_index;
+    playlist_apply_song(ctx, &playlist->songs[playlist->playing]);
+    playlist->songs_played++;
+    ma_atomic_bool32_set(&playlist->next_ready, MA_FALSE);
+    ma_event_signal(&playlist->wake); // Let the loader free the previous song and prefetch the next one
+    return PLAYLIST_SWITCHED;
+}
+
+void print_playlist_stats(const AudioContext *ctx)
+{
+    const Playlist *playlist = ctx->playlist;
+    printf("Playlist: %d of %d logs played, %.3f s in total\n", playlist->songs_played + 1, playlist->count,
+           (double)playback_elapsed_samples(ctx) / INTERNAL_SAMPLE_RATE);
+    if (playlist->gap_samples > 0)
+    {
+        printf("  ⚠️  %.1f ms of silence while waiting for the next log to load\n",
+               playlist->gap_samples * 1000.0 / INTERNAL_SAMPLE_RATE);
+    }
+    printf("\n");
+}
+
+// Stop the loader and free both songs
+void playlist_close(Playlist *playlist)
+{
+    if (playlist->thread_started)
+    {
+        ma_atomic_bool32_set(&playlist->stop, MA_TRUE);
+        ma_event_signal(&playlist->wake);
+        ma_thread_wait(&playlist->thread);
+        ma_event_uninit(&playlist->wake);
+        ma_event_uninit(&playlist->loaded);
+    }
+    playlist_free_song(&playlist->songs[0]);
+    playlist_free_song(&playlist->songs[1]);
+    free(playlist);
+}
+
+#endif // PLAYLIST_H
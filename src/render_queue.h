@@ -0,0 +1,126 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "types.h"
+
+// Bounded single-producer single-consumer queue of fixed-size blocks
+// Connects the offline render stages (offline_render.h) and feeds the FLAC encoder thread (flac_encoder.h).
+// The producer fills the block returned by render_queue_begin_write and publishes it with
+// render_queue_end_write; the consumer reads blocks in order and releases them. A side that finds the
+// queue full or empty blocks on an event the other side signals; the producer calls render_queue_finish
+// after the last block.
+
+#define RENDER_QUEUE_BLOCKS 16 // Blocks in flight between two stages (power of two)
+
+typedef struct
+{
+    // Single-producer single-consumer queue of fixed-size blocks
+    uint8_t *blocks;
+    size_t block_bytes;
+    size_t used[RENDER_QUEUE_BLOCKS]; // Frames or bytes stored in each block
+    ma_atomic_uint32 head;            // Next block to read (consumer)
+    ma_atomic_uint32 tail;            // Next block to write (producer)
+    ma_atomic_bool32 done;            // Set by the producer after the last block
+    ma_event space;                   // Signaled when a block is released (wakes a waiting producer)
+    ma_event filled;                  // Signaled when a block is published or the queue is done
+    uint64_t producer_waits;          // Times the producer found the queue full
+    uint64_t consumer_waits;          // Times the consumer found the queue empty
+} RenderQueue;
+
+static int render_queue_init(RenderQueue *queue, size_t block_bytes)
+{
+    memset(queue, 0, sizeof(RenderQueue));
+    queue->block_bytes = block_bytes;
+    queue->blocks = (uint8_t *)malloc(block_bytes * RENDER_QUEUE_BLOCKS);
+    if (!queue->blocks)
+    {
+        return 0;
+    }
+    if (ma_event_init(&queue->space) != MA_SUCCESS)
+    {
+        free(queue->blocks);
+        queue->blocks = NULL;
+        return 0;
+    }
+    if (ma_event_init(&queue->filled) != MA_SUCCESS)
+    {
+        ma_event_uninit(&queue->space);
+        free(queue->blocks);
+        queue->blocks = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// Free a queue set up by render_queue_init (no-op for a zeroed, never initialized queue)
+static void render_queue_free(RenderQueue *queue)
+{
+    if (queue->blocks)
+    {
+        ma_event_uninit(&queue->space);
+        ma_event_uninit(&queue->filled);
+        free(queue->blocks);
+        queue->blocks = NULL;
+    }
+}
+
+// Next free block, waits while the queue is full (producer only)
+static void *render_queue_begin_write(RenderQueue *queue)
+{
+    uint32_t tail = ma_atomic_uint32_get(&queue->tail);
+    if (tail - ma_atomic_uint32_get(&queue->head) >= RENDER_QUEUE_BLOCKS)
+    {
+        queue->producer_waits++;
+        while (tail - ma_atomic_uint32_get(&queue->head) >= RENDER_QUEUE_BLOCKS)
+        {
+            ma_event_wait(&queue->space); // Auto-reset: a release between the check and the wait is not lost
+        }
+    }
+    return queue->blocks + (size_t)(tail & (RENDER_QUEUE_BLOCKS - 1)) * queue->block_bytes;
+}
+
+// Publish the block returned by render_queue_begin_write
+static void render_queue_end_write(RenderQueue *queue, size_t used)
+{
+    uint32_t tail = ma_atomic_uint32_get(&queue->tail);
+    queue->used[tail & (RENDER_QUEUE_BLOCKS - 1)] = used;
+    ma_atomic_uint32_set(&queue->tail, tail + 1); // Publish after the block is filled
+    ma_event_signal(&queue->filled);
+}
+
+// No more blocks: wakes the consumer, whose begin_read returns NULL once the queue is drained (producer only)
+static void render_queue_finish(RenderQueue *queue)
+{
+    ma_atomic_bool32_set(&queue->done, MA_TRUE);
+    ma_event_signal(&queue->filled);
+}
+
+// Oldest filled block, waits while the queue is empty, NULL after the last block (consumer only)
+static void *render_queue_begin_read(RenderQueue *queue, size_t *used)
+{
+    uint32_t head = ma_atomic_uint32_get(&queue->head);
+    if (head == ma_atomic_uint32_get(&queue->tail))
+    {
+        queue->consumer_waits++;
+        while (head == ma_atomic_uint32_get(&queue->tail))
+        {
+            // 'done' is set after the last publish, so check the tail once more before giving up
+            if (ma_atomic_bool32_get(&queue->done) && head == ma_atomic_uint32_get(&queue->tail))
+            {
+                return NULL;
+            }
+            ma_event_wait(&queue->filled);
+        }
+    }
+    *used = queue->used[head & (RENDER_QUEUE_BLOCKS - 1)];
+    return queue->blocks + (size_t)(head & (RENDER_QUEUE_BLOCKS - 1)) * queue->block_bytes;
+}
+
+// Release the block returned by render_queue_begin_read
+static void render_queue_end_read(RenderQueue *queue)
+{
+    ma_atomic_uint32_set(&queue->head, ma_atomic_uint32_get(&queue->head) + 1);
+    ma_event_signal(&queue->space);
+}
+
+#endif // RENDER_QUEUE_H
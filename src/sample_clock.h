@@ -0,0 +1,46 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include "types.h"
+
+// Clocking of one output sample
+// Fixed mode runs CYCLES_PER_SAMPLE clocks and keeps the DAC output of the last one.
+// Strobe mode runs clocks until the DAC latches the next stereo sample: the falling edge of sh1
+// latches the right channel (the left one was latched on the sh2 edge 16 clocks before), so every
+// output sample is exactly one chip sample (CYCLES_PER_DAC_LATCH clocks), see test_sample_rate.c.
+
+// Run one clock. strobe_sh1 is NULL for fixed mode, otherwise it holds the previous sh1 state.
+// Returns 1 when the output sample is complete.
+static int sample_clock_step(opm_t *chip, int32_t *output, uint8_t *strobe_sh1, uint32_t clock_index)
+{
+    if (!strobe_sh1)
+    {
+        OPM_Clock(chip, output, NULL, NULL, NULL);
+        return clock_index + 1 >= CYCLES_PER_SAMPLE;
+    }
+
+    uint8_t sh1;
+    OPM_Clock(chip, output, &sh1, NULL, NULL);
+    int latched = *strobe_sh1 && !sh1;
+    *strobe_sh1 = sh1;
+    return latched;
+}
+
+// Clock one output sample
+void clock_sample(opm_t *chip, int32_t *output, uint8_t *strobe_sh1)
+{
+    if (!strobe_sh1)
+    {
+        for (int i = 0; i < CYCLES_PER_SAMPLE; i++)
+        {
+            OPM_Clock(chip, output, NULL, NULL, NULL);
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; !sample_clock_step(chip, output, strobe_sh1, i); i++)
+    {
+    }
+}
+
+#endif // SAMPLE_CLOCK_H
@@ -0,0 +1,169 @@
+#ifndef SAMPLE_CONVERT_H
+#define SAMPLE_CONVERT_H
+
+#include "types.h"
+
+// Sample conversion kernels
+// Convert raw DAC output (int32 values in 16-bit range, interleaved stereo) into the output formats.
+// 'count' is the number of values (frames * 2). On x86 the SSE2 paths process 8 values per step;
+// the scalar loops handle the tail and other targets (simple enough for compilers to auto-vectorize).
+
+// Output sample format for WAV file and live playback
+typedef enum
+{
+    SAMPLE_FORMAT_S16 = 0,  // 16-bit PCM, DAC output halved (legacy behaviour)
+    SAMPLE_FORMAT_S16_CLIP, // 16-bit PCM, full DAC range with saturation
+    SAMPLE_FORMAT_S24,      // 24-bit PCM, full DAC range
+    SAMPLE_FORMAT_F32       // 32-bit IEEE float, full DAC range (1.0 = 32768)
+} SampleFormat;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SAMPLE_CONVERT_SSE2
+#endif
+
+// Legacy 16-bit conversion: divide by 2 (rounding toward zero)
+void convert_to_s16_half(const int32_t *in, int16_t *out, size_t count)
+{
+    size_t i = 0;
+#ifdef SAMPLE_CONVERT_SSE2
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i + 4));
+        // x / 2 rounds toward zero: add the sign bit before the arithmetic shift
+        a = _mm_srai_epi32(_mm_add_epi32(a, _mm_srli_epi32(a, 31)), 1);
+        b = _mm_srai_epi32(_mm_add_epi32(b, _mm_srli_epi32(b, 31)), 1);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = (int16_t)(in[i] / 2);
+    }
+}
+
+// Full-range 16-bit conversion with saturation
+void convert_to_s16_clip(const int32_t *in, int16_t *out, size_t count)
+{
+    size_t i = 0;
+#ifdef SAMPLE_CONVERT_SSE2
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i + 4));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b)); // packs saturates to int16
+    }
+#endif
+    for (; i < count; i++)
+    {
+        int32_t v = in[i];
+        v = v > INT16_MAX ? INT16_MAX : v;
+        v = v < INT16_MIN ? INT16_MIN : v;
+        out[i] = (int16_t)v;
+    }
+}
+
+// Full-range float conversion (32768 = 1.0)
+void convert_to_f32(const int32_t *in, float *out, size_t count)
+{
+    const float scale = 1.0f / 32768.0f;
+    size_t i = 0;
+#ifdef SAMPLE_CONVERT_SSE2
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + i + 4));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(a), vscale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), vscale));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = (float)in[i] * scale;
+    }
+}
+
+// Full-range 24-bit conversion (packed little-endian, 3 bytes per value)
+void convert_to_s24(const int32_t *in, uint8_t *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t v = in[i];
+        // DAC output (-32768..32704) never reaches the clamp; it guards wider inputs such as pre-DAC stem sums
+        v = v > INT16_MAX ? INT16_MAX : v;
+        v = v < INT16_MIN ? INT16_MIN : v;
+        uint32_t u = (uint32_t)v << 8;
+        out[i * 3] = (uint8_t)u;
+        out[i * 3 + 1] = (uint8_t)(u >> 8);
+        out[i * 3 + 2] = (uint8_t)(u >> 16);
+    }
+}
+
+// Convert to any output format (out must hold count * sample_format_bytes(format) bytes)
+void convert_samples(SampleFormat format, const int32_t *in, void *out, size_t count)
+{
+    switch (format)
+    {
+    case SAMPLE_FORMAT_S16_CLIP:
+        convert_to_s16_clip(in, (int16_t *)out, count);
+        break;
+    case SAMPLE_FORMAT_S24:
+        convert_to_s24(in, (uint8_t *)out, count);
+        break;
+    case SAMPLE_FORMAT_F32:
+        convert_to_f32(in, (float *)out, count);
+        break;
+    case SAMPLE_FORMAT_S16:
+    default:
+        convert_to_s16_half(in, (int16_t *)out, count);
+        break;
+    }
+}
+
+// Bytes per value of a sample format
+uint32_t sample_format_bytes(SampleFormat format)
+{
+    switch (format)
+    {
+    case SAMPLE_FORMAT_S24:
+        return 3;
+    case SAMPLE_FORMAT_F32:
+        return 4;
+    default:
+        return 2;
+    }
+}
+
+const char *sample_format_name(SampleFormat format)
+{
+    switch (format)
+    {
+    case SAMPLE_FORMAT_S16_CLIP:
+        return "s16clip";
+    case SAMPLE_FORMAT_S24:
+        return "s24";
+    case SAMPLE_FORMAT_F32:
+        return "f32";
+    default:
+        return "s16";
+    }
+}
+
+// Parse format name ("s16", "s16clip", "s24", "f32"), returns 0 if unknown
+int parse_sample_format(const char *name, SampleFormat *format)
+{
+    static const SampleFormat formats[] = {SAMPLE_FORMAT_S16, SAMPLE_FORMAT_S16_CLIP, SAMPLE_FORMAT_S24, SAMPLE_FORMAT_F32};
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        if (strcmp(name, sample_format_name(formats[i])) == 0)
+        {
+            *format = formats[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#endif // SAMPLE_CONVERT_H
@@ -0,0 +1,224 @@
+/* Round trip test for the FLAC encoder (flac_encoder.h)
+ * Encodes synthetic signals (silence, tones, noise, full-scale steps, mono, short and odd lengths) in
+ * s16, s16clip and s24, decodes them with the FLAC decoder built into miniaudio (dr_flac) and checks
+ * that every sample matches the converted PCM. Optionally encodes the audio of a player WAV file (s16)
+ * the same way and reports the size.
+ * Build: gcc -O2 -o test_flac src/test_flac.c opm.c -lm -lpthread -fwrapv
+ * Usage: ./test_flac [output.wav]
+ */
+
+// Headless except for miniaudio's decoders (YM2151_HEADLESS would leave them out)
+#define MA_NO_DEVICE_IO
+#define MA_NO_ENCODING
+#define MA_NO_GENERATION
+#define MA_NO_RESOURCE_MANAGER
+#define MA_NO_NODE_GRAPH
+#define MA_NO_ENGINE
+#include "flac_encoder.h"
+
+#define TEST_FLAC_FILENAME "test_flac_output.flac"
+
+// Raw DAC values (int32, a bit beyond the 16-bit range to exercise the saturating formats)
+static void generate_signal(int kind, int32_t *raw, uint32_t frames)
+{
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        int32_t noise = (int32_t)(seed >> 16) - 32768;
+        double t = (double)i / INTERNAL_SAMPLE_RATE;
+        int32_t left, right;
+        switch (kind)
+        {
+        case 0: // Silence
+            left = right = 0;
+            break;
+        case 1: // Two tones
+            left = (int32_t)(20000 * sin(2 * M_PI * 440 * t));
+            right = (int32_t)(12000 * sin(2 * M_PI * 660 * t + 1.0));
+            break;
+        case 2: // White noise
+            left = noise;
+            right = (int32_t)((seed >> 3) & 0xFFFF) - 32768;
+            break;
+        case 3: // Full-scale square wave with values past the 16-bit range
+            left = (i / 37) % 2 ? 40000 : -40000;
+            right = (i / 53) % 2 ? 32767 : -32768;
+            break;
+        case 4: // Decaying FM tone with a little noise
+            left = (int32_t)(30000 * exp(-3 * t) * sin(2 * M_PI * 220 * t + 2 * sin(2 * M_PI * 440 * t))) + noise / 256;
+            right = left / 2 + noise / 512;
+            break;
+        default: // Mono (side channel constant)
+            left = right = (int32_t)(25000 * sin(2 * M_PI * 1000 * t));
+            break;
+        }
+        raw[i * 2] = left;
+        raw[i * 2 + 1] = right;
+    }
+}
+
+// Decode a FLAC file to int32 frames (dr_flac output: samples in the high bits), returns frames decoded
+static ma_uint64 decode_flac(const char *filename, int32_t *out, ma_uint64 capacity, ma_uint32 *rate)
+{
+    ma_decoder_config config = ma_decoder_config_init(ma_format_s32, 2, 0);
+    ma_decoder decoder;
+    if (ma_decoder_init_file(filename, &config, &decoder) != MA_SUCCESS)
+    {
+        return 0;
+    }
+    ma_uint64 frames = 0;
+    ma_decoder_read_pcm_frames(&decoder, out, capacity, &frames);
+    *rate = decoder.outputSampleRate;
+    ma_decoder_uninit(&decoder);
+    return frames;
+}
+
+// Expected decoder output: the converted PCM in the high bits of int32
+static void expected_samples(SampleFormat format, const int32_t *raw, size_t count, int32_t *expected)
+{
+    uint8_t *pcm = (uint8_t *)malloc(count * 3 + 1);
+    convert_samples(format, raw, pcm, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (format == SAMPLE_FORMAT_S24)
+        {
+            expected[i] = (int32_t)((uint32_t)pcm[i * 3] << 8 | (uint32_t)pcm[i * 3 + 1] << 16 |
+                                    (uint32_t)pcm[i * 3 + 2] << 24);
+        }
+        else
+        {
+            int16_t value;
+            memcpy(&value, pcm + i * 2, sizeof(value));
+            expected[i] = (int32_t)((uint32_t)value << 16);
+        }
+    }
+    free(pcm);
+}
+
+static long file_size(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+// Encode, decode and compare one signal, returns 1 if identical
+static int round_trip(int kind, uint32_t frames, SampleFormat format)
+{
+    int32_t *raw = (int32_t *)malloc(((size_t)frames * 2 + 1) * sizeof(int32_t));
+    int32_t *expected = (int32_t *)malloc(((size_t)frames * 2 + 1) * sizeof(int32_t));
+    int32_t *decoded = (int32_t *)malloc(((size_t)frames * 2 + 16) * sizeof(int32_t));
+    generate_signal(kind, raw, frames);
+    expected_samples(format, raw, (size_t)frames * 2, expected);
+
+    int ok = save_flac_file(TEST_FLAC_FILENAME, raw, frames, format);
+    ma_uint32 rate = 0;
+    ma_uint64 decoded_frames = ok ? decode_flac(TEST_FLAC_FILENAME, decoded, frames + 8, &rate) : 0;
+    ok = ok && decoded_frames == frames && rate == INTERNAL_SAMPLE_RATE &&
+         memcmp(decoded, expected, (size_t)frames * 2 * sizeof(int32_t)) == 0;
+    if (!ok)
+    {
+        fprintf(stderr, "❌ Signal %d, %u frames, %s: decoded %llu frames at %u Hz, samples differ\n", kind, frames,
+                sample_format_name(format), (unsigned long long)decoded_frames, rate);
+    }
+    remove(TEST_FLAC_FILENAME);
+    free(raw);
+    free(expected);
+    free(decoded);
+    return ok;
+}
+
+// Encode the s16 data of a player WAV file (44-byte header) and compare the decoded samples
+static int encode_wav(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    long size = file_size(filename);
+    if (!fp || size < 44)
+    {
+        fprintf(stderr, "❌ Failed to read %s\n", filename);
+        return 0;
+    }
+    size_t frames = (size_t)(size - 44) / 4;
+    uint8_t *pcm = (uint8_t *)malloc(frames * 4 + 1);
+    fseek(fp, 44, SEEK_SET);
+    frames = fread(pcm, 4, frames, fp);
+    fclose(fp);
+
+    double start = flac_now_ms();
+    FlacEncoder *enc = flac_encoder_open(TEST_FLAC_FILENAME, SAMPLE_FORMAT_S16, INTERNAL_SAMPLE_RATE);
+    int ok = enc != NULL;
+    for (size_t i = 0; enc && i < frames; i += FLAC_BLOCK_FRAMES)
+    {
+        size_t count = frames - i < FLAC_BLOCK_FRAMES ? frames - i : FLAC_BLOCK_FRAMES;
+        flac_encoder_write(enc, pcm + i * 4, count);
+    }
+    ok = ok && flac_encoder_close(enc, TEST_FLAC_FILENAME);
+    double encode_ms = flac_now_ms() - start;
+    long flac_size = file_size(TEST_FLAC_FILENAME);
+
+    int32_t *decoded = (int32_t *)malloc((frames * 2 + 16) * sizeof(int32_t));
+    ma_uint32 rate;
+    ma_uint64 decoded_frames = ok ? decode_flac(TEST_FLAC_FILENAME, decoded, frames + 8, &rate) : 0;
+    for (size_t i = 0; ok && i < frames * 2; i++)
+    {
+        int16_t value;
+        memcpy(&value, pcm + i * 2, sizeof(value));
+        ok = decoded[i] == (int32_t)((uint32_t)value << 16);
+    }
+    ok = ok && decoded_frames == frames;
+    if (ok)
+    {
+        printf("✅ %s: %ld bytes as WAV, %ld bytes as FLAC (%.1f%%), %.1f ms\n", filename, size, flac_size,
+               flac_size * 100.0 / size, encode_ms);
+    }
+    else
+    {
+        fprintf(stderr, "❌ %s: decoded FLAC differs from the WAV data\n", filename);
+    }
+    remove(TEST_FLAC_FILENAME);
+    free(pcm);
+    free(decoded);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    printf("FLAC Encoder Test\n");
+    printf("=================\n\n");
+
+    static const uint32_t lengths[] = {1, 15, FLAC_BLOCK_FRAMES, FLAC_BLOCK_FRAMES + 1, 10000, INTERNAL_SAMPLE_RATE * 2 + 123};
+    static const SampleFormat formats[] = {SAMPLE_FORMAT_S16, SAMPLE_FORMAT_S16_CLIP, SAMPLE_FORMAT_S24};
+    int failures = 0;
+    int runs = 0;
+    for (int kind = 0; kind < 6; kind++)
+    {
+        for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+        {
+            for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+            {
+                failures += !round_trip(kind, lengths[l], formats[f]);
+                runs++;
+            }
+        }
+    }
+    if (failures)
+    {
+        fprintf(stderr, "\n❌ %d of %d round trips failed\n", failures, runs);
+        return 1;
+    }
+    printf("\n✅ %d synthetic round trips are lossless\n", runs);
+
+    if (argc >= 2 && !encode_wav(argv[1]))
+    {
+        return 1;
+    }
+    printf("\n✅ Test passed!\n");
+    return 0;
+}
@@ -1,8 +1,148 @@
 /* Simple test program to verify JSON loading functionality */
 
-#include "types.h"
-#include "events.h"
-#include "json_loader.h"
+#define YM2151_HEADLESS // No audio device: emulation, threads and file IO only
+#include "event_cache.h"
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static char *read_text(const char *filename, size_t *size)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *text = (char *)malloc(file_size + 1);
+    *size = text ? fread(text, 1, file_size, fp) : 0;
+    if (text)
+    {
+        text[*size] = '\0';
+    }
+    fclose(fp);
+    return text;
+}
+
+// Field by field (the padding byte of RegisterEvent is not initialized)
+static int same_events(const RegisterEventList *a, const RegisterEventList *b)
+{
+    if (a->count != b->count)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < a->count; i++)
+    {
+        const RegisterEvent *x = &a->events[i];
+        const RegisterEvent *y = &b->events[i];
+        if (x->sample_time != y->sample_time || x->address != y->address || x->data != y->data ||
+            x->is_data_write != y->is_data_write)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int check_parallel_parse(const char *json_filename)
+{
+    size_t size;
+    char *text = read_text(json_filename, &size);
+    if (!text)
+    {
+        fprintf(stderr, "❌ Failed to read %s\n", json_filename);
+        return 0;
+    }
+    double start = now_ms();
+    RegisterEventList *sequential = parse_events_json_pass1(text);
+    double sequential_ms = now_ms() - start;
+    int ok = 1;
+    double parallel_ms = 0.0;
+    static const int thread_counts[] = {2, 3, 4, 7, 16};
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]) && ok; i++)
+    {
+        start = now_ms();
+        RegisterEventList *parallel = parse_events_json_pass1_parallel(text, size, thread_counts[i]);
+        parallel_ms = now_ms() - start;
+        ok = same_events(parallel, sequential) && memcmp(&parallel->loop, &sequential->loop, sizeof(LoopMarker)) == 0;
+        if (!ok)
+        {
+            fprintf(stderr, "❌ Parallel parse on %d threads differs from the sequential parse\n", thread_counts[i]);
+        }
+        free_event_list(parallel);
+    }
+    if (ok)
+    {
+        printf("✅ Parallel parse matches: sequential %.2f ms, %d threads %.2f ms\n\n", sequential_ms,
+               thread_counts[sizeof(thread_counts) / sizeof(thread_counts[0]) - 1], parallel_ms);
+    }
+    free_event_list(sequential);
+    free(text);
+    return ok;
+}
+
+// Reference order for the radix sort check: time, then position before the sort (kept in address/data)
+static int compare_time_then_position(const void *a, const void *b)
+{
+    const RegisterEvent *x = (const RegisterEvent *)a;
+    const RegisterEvent *y = (const RegisterEvent *)b;
+    if (x->sample_time != y->sample_time)
+    {
+        return x->sample_time < y->sample_time ? -1 : 1;
+    }
+    int position_x = x->address << 8 | x->data;
+    int position_y = y->address << 8 | y->data;
+    return position_x - position_y;
+}
+
+// Sort a merged-capture style list (two interleaved time ranges, many equal times) and a list of random
+// 32-bit times, and compare with qsort on (time, original position)
+static int check_time_sort(void)
+{
+    const size_t count = 65536;
+    int ok = 1;
+    for (int pattern = 0; pattern < 2 && ok; pattern++)
+    {
+        RegisterEventList *list = create_event_list();
+        uint32_t seed = 12345;
+        for (size_t i = 0; i < count; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            uint32_t time = pattern == 0 ? (uint32_t)(i % 2 ? i / 2 : count + i / 2) / 16 : seed ^ (seed << 7);
+            add_event_with_flag(list, time, (uint8_t)(i >> 8), (uint8_t)i, 0);
+        }
+        RegisterEvent *expected = (RegisterEvent *)malloc(count * sizeof(RegisterEvent));
+        memcpy(expected, list->events, count * sizeof(RegisterEvent));
+        qsort(expected, count, sizeof(RegisterEvent), compare_time_then_position);
+
+        double start = now_ms();
+        int sorted = sort_events_by_time(list);
+        double sort_ms = now_ms() - start;
+        RegisterEventList reference = *list;
+        reference.events = expected;
+        ok = sorted && same_events(list, &reference) && count_unsorted_events(list) == 0 &&
+             sort_events_by_time(list) == 0;
+        if (ok)
+        {
+            printf("✅ Time sort (%s): %zu events in %.2f ms, stable\n", pattern == 0 ? "merged" : "random", count,
+                   sort_ms);
+        }
+        else
+        {
+            fprintf(stderr, "❌ Time sort (%s) differs from a stable sort\n", pattern == 0 ? "merged" : "random");
+        }
+        free(expected);
+        free_event_list(list);
+    }
+    printf("\n");
+    return ok;
+}
 
 int main(int argc, char **argv)
 {
@@ -18,13 +158,48 @@ int main(int argc, char **argv)
     const char *json_filename = argv[1];
 
     // Load events from JSON file
+    double parse_start = now_ms();
     RegisterEventList *events = load_events_json(json_filename);
+    double parse_ms = now_ms() - parse_start;
     if (!events)
     {
         fprintf(stderr, "❌ Failed to load events\n");
         return 1;
     }
 
+    // Sidecar cache round trip: the mapped events must be identical to the parsed ones
+    if (!save_event_cache(json_filename, events))
+    {
+        fprintf(stderr, "❌ Failed to save event cache\n");
+        return 1;
+    }
+    double cache_start = now_ms();
+    RegisterEventList *cached = load_event_cache(json_filename);
+    double cache_ms = now_ms() - cache_start;
+    char *cache_filename = event_cache_filename(json_filename);
+    remove(cache_filename);
+    free(cache_filename);
+    if (!cached || cached->count != events->count ||
+        memcmp(cached->events, events->events, events->count * sizeof(RegisterEvent)) != 0 ||
+        cached->loop.enabled != events->loop.enabled || cached->loop.start_index != events->loop.start_index)
+    {
+        fprintf(stderr, "❌ Cached events differ from the parsed events\n");
+        return 1;
+    }
+    printf("✅ Event cache round trip: parse %.2f ms, cache load %.2f ms\n\n", parse_ms, cache_ms);
+    free_event_list(cached);
+
+    if (!check_time_sort())
+    {
+        return 1;
+    }
+
+    // Parallel parsing must give the same pass1 events as the sequential parser for any chunk count
+    if (!check_parallel_parse(json_filename))
+    {
+        return 1;
+    }
+
     printf("Event details:\n");
     printf("  Total events: %zu\n", events->count);
 
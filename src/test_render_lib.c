@@ -0,0 +1,181 @@
+/* Test program for the render library API (ym2151_render.h)
+ * Renders a JSON log from memory twice with one renderer (different block sizes) and checks that
+ * the results are identical, then renders a song built from a write array. Text without a complete event
+ * must not load.
+ * Optionally compares the render with a player output.wav (s16) of the same log.
+ * Build: python3 build.py build-lib
+ *        gcc -O2 -o test_render_lib src/test_render_lib.c libym2151render.a -lm -lpthread
+ * Usage: ./test_render_lib <json_log_file> [player_output.wav]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ym2151_render.h"
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static char *read_file(const char *filename, size_t *size)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "❌ Failed to open %s for reading\n", filename);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *buffer = (char *)malloc(file_size > 0 ? file_size : 1);
+    *size = buffer ? fread(buffer, 1, file_size, fp) : 0;
+    fclose(fp);
+    return buffer;
+}
+
+// Render the whole song in blocks of block_frames, returns frames rendered
+static size_t render_all(ym2151_renderer_t *renderer, const ym2151_song_t *song, int16_t *out, size_t block_frames)
+{
+    size_t total = 0;
+    size_t n;
+    ym2151_renderer_start(renderer, song);
+    while ((n = ym2151_renderer_render(renderer, out + total * 2, block_frames, YM2151_FORMAT_S16)) > 0)
+    {
+        total += n;
+    }
+    return total;
+}
+
+int main(int argc, char **argv)
+{
+    printf("Render Library Test\n");
+    printf("===================\n\n");
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <json_log_file> [player_output.wav]\n", argv[0]);
+        return 1;
+    }
+
+    size_t json_size;
+    char *json = read_file(argv[1], &json_size);
+    if (!json)
+    {
+        return 1;
+    }
+
+    double t0 = now_ms();
+    ym2151_song_t *song = ym2151_song_from_json(json, json_size);
+    double load_ms = now_ms() - t0;
+    free(json);
+    if (!song)
+    {
+        fprintf(stderr, "❌ Failed to load song\n");
+        return 1;
+    }
+    uint32_t length = ym2151_song_length(song);
+    printf("Song: %u frames (%.2f s at %u Hz), parsed in %.2f ms\n", length, (double)length / ym2151_sample_rate(),
+           ym2151_sample_rate(), load_ms);
+
+    // Text without a complete event (the last one lacks "data") is not a song
+    int ok = 1;
+    const char *truncated = "{\"events\":[{\"time\":1,\"addr\":\"0x08\"";
+    ym2151_song_t *invalid = ym2151_song_from_json(truncated, strlen(truncated));
+    if (invalid)
+    {
+        fprintf(stderr, "❌ Truncated JSON loaded as a song of %u frames\n", ym2151_song_length(invalid));
+        ym2151_song_free(invalid);
+        ok = 0;
+    }
+    else
+    {
+        printf("✅ Truncated JSON is rejected\n");
+    }
+
+    // Song from a write array (rendered last): one note on channel 1 must produce sound
+    ym2151_write_t writes[] = {
+        {0, 0x20, 0xC7}, {0, 0x28, 0x4A}, {0, 0x60, 0x7F}, {0, 0x68, 0x7F}, {0, 0x70, 0x7F}, {0, 0x78, 0x00},
+        {0, 0x80, 0x1F}, {0, 0x88, 0x1F}, {0, 0x90, 0x1F}, {0, 0x98, 0x1F}, {0, 0xE0, 0x0F}, {0, 0xE8, 0x0F},
+        {0, 0xF0, 0x0F}, {0, 0xF8, 0x0F}, {0, 0x40, 0x01}, {0, 0x48, 0x01}, {0, 0x50, 0x01}, {0, 0x58, 0x01},
+        {100, 0x08, 0x78},
+    };
+    ym2151_song_t *note = ym2151_song_from_writes(writes, sizeof(writes) / sizeof(writes[0]));
+    uint32_t capacity = length > ym2151_song_length(note) ? length : ym2151_song_length(note);
+
+    int16_t *a = (int16_t *)malloc((size_t)capacity * 2 * sizeof(int16_t));
+    int16_t *b = (int16_t *)malloc((size_t)length * 2 * sizeof(int16_t));
+    ym2151_renderer_t *renderer = ym2151_renderer_create();
+    if (!a || !b || !renderer)
+    {
+        fprintf(stderr, "❌ Failed to allocate buffers\n");
+        return 1;
+    }
+
+    t0 = now_ms();
+    size_t frames_a = render_all(renderer, song, a, 4096);
+    double render_ms = now_ms() - t0;
+    size_t frames_b = render_all(renderer, song, b, 1000); // Same renderer reused, different block size
+    printf("Rendered %zu frames in %.1f ms (%.1fx real time)\n", frames_a, render_ms,
+           render_ms > 0 ? frames_a * 1000.0 / ym2151_sample_rate() / render_ms : 0.0);
+    if (frames_a != length || frames_b != length || memcmp(a, b, (size_t)length * 2 * sizeof(int16_t)) != 0)
+    {
+        fprintf(stderr, "❌ Reused renderer or different block size gave different output\n");
+        ok = 0;
+    }
+    else
+    {
+        printf("✅ Reused renderer renders identical output with a different block size\n");
+    }
+
+    // Compare with the player's WAV data (44-byte header, s16)
+    if (argc >= 3)
+    {
+        size_t wav_size;
+        char *wav = read_file(argv[2], &wav_size);
+        if (!wav || wav_size != 44 + (size_t)length * 4 || memcmp(wav + 44, a, (size_t)length * 4) != 0)
+        {
+            fprintf(stderr, "❌ Render differs from %s\n", argv[2]);
+            ok = 0;
+        }
+        else
+        {
+            printf("✅ Render matches %s\n", argv[2]);
+        }
+        free(wav);
+    }
+
+    // Song from a write array
+    size_t note_frames = render_all(renderer, note, a, 4096);
+    int peak = 0;
+    for (size_t i = 0; i < note_frames * 2; i++)
+    {
+        peak = abs(a[i]) > peak ? abs(a[i]) : peak;
+    }
+    if (note_frames != ym2151_song_length(note) || peak == 0)
+    {
+        fprintf(stderr, "❌ Write array song rendered %zu frames, peak %d\n", note_frames, peak);
+        ok = 0;
+    }
+    else
+    {
+        printf("✅ Write array song: %zu frames, peak %d\n", note_frames, peak);
+    }
+
+    ym2151_song_free(note);
+    ym2151_song_free(song);
+    ym2151_renderer_free(renderer);
+    free(a);
+    free(b);
+
+    if (!ok)
+    {
+        return 1;
+    }
+    printf("\n✅ Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,165 @@
+/* Self-test: DAC latch rate and clocks per sample
+ * Counts the sh1/sh2 strobe edges of the emulator, compares the rate of emitted samples with
+ * INTERNAL_SAMPLE_RATE for fixed (CYCLES_PER_SAMPLE clocks) and strobe capture, and measures the
+ * pitch of A4 (KC 0x4A, 440 Hz on a 3.579545 MHz YM2151) in both modes.
+ * Build: gcc -O2 -o test_sample_rate src/test_sample_rate.c opm.c -lm -lpthread -fwrapv
+ */
+
+#define YM2151_HEADLESS // No audio device: emulation, threads and file IO only
+#include "sample_clock.h"
+
+#define TEST_SECONDS 1
+#define A4_FREQUENCY 440.0
+
+// Write one register (address and data DELAY_SAMPLES apart, like pass2)
+static void write_register(opm_t *chip, uint8_t address, uint8_t data, uint8_t *strobe_sh1)
+{
+    int32_t output[2];
+    OPM_Write(chip, OPM_ADDRESS_REGISTER, address);
+    for (int i = 0; i < DELAY_SAMPLES; i++)
+    {
+        clock_sample(chip, output, strobe_sh1);
+    }
+    OPM_Write(chip, OPM_DATA_REGISTER, data);
+    for (int i = 0; i < DELAY_SAMPLES; i++)
+    {
+        clock_sample(chip, output, strobe_sh1);
+    }
+}
+
+// Key on a sine wave (single carrier, MUL 1) at A4 on channel 0
+static void key_on_a4(opm_t *chip, uint8_t *strobe_sh1)
+{
+    write_register(chip, 0x20, 0xC7, strobe_sh1); // L+R, connection 7 (all carriers)
+    for (int op = 0; op < 4; op++)
+    {
+        write_register(chip, 0x40 + op * 8, 0x01, strobe_sh1);                // DT1 0, MUL 1
+        write_register(chip, 0x60 + op * 8, op == 3 ? 0x00 : 0x7F, strobe_sh1); // Only one operator audible
+        write_register(chip, 0x80 + op * 8, 0x1F, strobe_sh1);                // AR max
+        write_register(chip, 0xE0 + op * 8, 0x0F, strobe_sh1);                // D1L 0, RR max
+    }
+    write_register(chip, 0x28, 0x4A, strobe_sh1); // KC: octave 4, note A
+    write_register(chip, 0x30, 0x00, strobe_sh1); // KF 0
+    write_register(chip, 0x08, 0x78, strobe_sh1); // Key on all operators of channel 0
+}
+
+// Render TEST_SECONDS of output samples, returns measured pitch of the left channel in Hz
+static double measure_pitch(uint8_t *strobe_sh1, uint64_t *clocks_used)
+{
+    opm_t *chip = (opm_t *)calloc(1, sizeof(opm_t));
+    if (!chip)
+    {
+        fprintf(stderr, "❌ Failed to allocate chip\n");
+        exit(1);
+    }
+    OPM_Reset(chip);
+    key_on_a4(chip, strobe_sh1);
+
+    // Rising zero crossings over a whole number of output samples
+    uint32_t samples = INTERNAL_SAMPLE_RATE * TEST_SECONDS;
+    uint32_t crossings = 0;
+    uint32_t first_crossing = 0;
+    uint32_t last_crossing = 0;
+    int32_t previous = 0;
+    *clocks_used = 0;
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        int32_t output[2] = {0, 0};
+        uint32_t clocks = 0;
+        while (!sample_clock_step(chip, output, strobe_sh1, clocks))
+        {
+            clocks++;
+        }
+        *clocks_used += clocks + 1;
+        if (previous < 0 && output[0] >= 0)
+        {
+            if (crossings == 0)
+            {
+                first_crossing = i;
+            }
+            last_crossing = i;
+            crossings++;
+        }
+        previous = output[0];
+    }
+    free(chip);
+
+    if (crossings < 2)
+    {
+        return 0.0;
+    }
+    return (crossings - 1) * (double)INTERNAL_SAMPLE_RATE / (last_crossing - first_crossing);
+}
+
+int main(void)
+{
+    printf("Sample Rate Self-Test\n");
+    printf("=====================\n\n");
+
+    // 1. DAC latches per clock
+    opm_t *chip = (opm_t *)calloc(1, sizeof(opm_t));
+    if (!chip)
+    {
+        fprintf(stderr, "❌ Failed to allocate chip\n");
+        return 1;
+    }
+    OPM_Reset(chip);
+    uint64_t clocks = (uint64_t)INTERNAL_SAMPLE_RATE * CYCLES_PER_SAMPLE;
+    uint64_t sh1_edges = 0;
+    uint64_t sh2_edges = 0;
+    uint8_t sh1 = 0, sh2 = 0, old_sh1 = 0, old_sh2 = 0;
+    for (uint64_t i = 0; i < clocks; i++)
+    {
+        OPM_Clock(chip, NULL, &sh1, &sh2, NULL);
+        sh1_edges += old_sh1 && !sh1;
+        sh2_edges += old_sh2 && !sh2;
+        old_sh1 = sh1;
+        old_sh2 = sh2;
+    }
+    free(chip);
+    double clocks_per_latch = (double)clocks / sh1_edges;
+    printf("DAC latches: %llu right (sh1), %llu left (sh2) in %llu clocks: one per %.2f clocks\n",
+           (unsigned long long)sh1_edges, (unsigned long long)sh2_edges, (unsigned long long)clocks, clocks_per_latch);
+
+    // 2. Emitted sample rate when the player runs CYCLES_PER_SAMPLE clocks per INTERNAL_SAMPLE_RATE sample
+    double emitted_rate = (double)INTERNAL_SAMPLE_RATE * CYCLES_PER_SAMPLE / clocks_per_latch;
+    printf("Fixed capture (%d clocks per sample): chip emits %.0f samples/s, INTERNAL_SAMPLE_RATE is %d (%.2fx)\n",
+           CYCLES_PER_SAMPLE, emitted_rate, INTERNAL_SAMPLE_RATE, emitted_rate / INTERNAL_SAMPLE_RATE);
+
+    // 3. Pitch in both modes
+    uint64_t fixed_clocks, strobe_clocks;
+    uint8_t strobe_sh1 = 0;
+    double fixed_pitch = measure_pitch(NULL, &fixed_clocks);
+    double strobe_pitch = measure_pitch(&strobe_sh1, &strobe_clocks);
+    printf("A4 (KC 0x4A) pitch: fixed %.1f Hz, strobe %.1f Hz (expected %.1f Hz)\n", fixed_pitch, strobe_pitch,
+           A4_FREQUENCY);
+    printf("Clocks per output sample: fixed %.2f, strobe %.2f\n\n", (double)fixed_clocks / INTERNAL_SAMPLE_RATE,
+           (double)strobe_clocks / INTERNAL_SAMPLE_RATE);
+
+    int ok = 1;
+    if (fabs((double)strobe_clocks / INTERNAL_SAMPLE_RATE - clocks_per_latch) > 0.01 ||
+        fabs(clocks_per_latch - CYCLES_PER_DAC_LATCH) > 0.01)
+    {
+        fprintf(stderr, "❌ Strobe capture does not emit one sample per DAC latch\n");
+        ok = 0;
+    }
+    if (fabs(strobe_pitch - A4_FREQUENCY) > A4_FREQUENCY * 0.01)
+    {
+        fprintf(stderr, "❌ Strobe capture pitch is off\n");
+        ok = 0;
+    }
+    if (fabs(emitted_rate - INTERNAL_SAMPLE_RATE) > 1.0)
+    {
+        printf("⚠️  Fixed capture keeps 1 of %.0f emitted samples: the chip runs %.2fx faster than INTERNAL_SAMPLE_RATE\n",
+               emitted_rate / INTERNAL_SAMPLE_RATE, emitted_rate / INTERNAL_SAMPLE_RATE);
+        printf("    (pitch, envelopes, LFO and timers scale with it). Strobe capture needs %.0f clocks per sample.\n\n",
+               clocks_per_latch);
+    }
+
+    if (!ok)
+    {
+        return 1;
+    }
+    printf("✅ Test passed!\n");
+    return 0;
+}
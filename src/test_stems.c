@@ -0,0 +1,175 @@
+/* Test for per-channel stem capture (OPM_SetStemCapture / OPM_GetStems)
+ * Plays tones on several channels (both outputs, left only, right only, a feedback patch), keys them off
+ * and on again, and compares the sum of the stems of each output sample with the master DAC output in
+ * fixed and strobe capture. The stems are the exact mixer sums of the sample the DAC outputs, so the two
+ * differ only by the DAC's floating point conversion: 10 mantissa bits, of which the emulated serial
+ * transfer to the DAC leaves the top 6 exact (the low 4 can come out different), so a value is less than
+ * 16 quantization steps off. A stem that is one sample early or late is off by the change of the signal
+ * from one sample to the next, which the mean error comparison catches.
+ * Build: gcc -O2 -o test_stems src/test_stems.c opm.c -lm -lpthread -fwrapv
+ * Usage: ./test_stems
+ */
+
+#define YM2151_HEADLESS // No audio device: emulation, threads and file IO only
+#include "sample_clock.h"
+
+#define TEST_SAMPLES (INTERNAL_SAMPLE_RATE / 2)
+
+typedef struct
+{
+    uint64_t frames;        // Output values compared (left and right)
+    uint64_t sounding;      // Values with a non-zero stem sum
+    uint64_t over_bound;    // Values 16 or more quantization steps from the stem sum
+    double error_sum;       // Sum of |master - stem sum|
+    double shifted_sum;     // Sum of |master - stem sum of the previous sample|
+    int32_t worst_error;
+    int32_t worst_sum;
+} StemStats;
+
+// Write one register (address and data DELAY_SAMPLES apart, like pass2)
+static void write_register(opm_t *chip, uint8_t address, uint8_t data, uint8_t *strobe_sh1)
+{
+    int32_t output[2];
+    OPM_Write(chip, OPM_ADDRESS_REGISTER, address);
+    for (int i = 0; i < DELAY_SAMPLES; i++)
+    {
+        clock_sample(chip, output, strobe_sh1);
+    }
+    OPM_Write(chip, OPM_DATA_REGISTER, data);
+    for (int i = 0; i < DELAY_SAMPLES; i++)
+    {
+        clock_sample(chip, output, strobe_sh1);
+    }
+}
+
+// Single sine carrier (like test_sample_rate.c) or a 2-operator feedback patch
+static void set_patch(opm_t *chip, uint8_t channel, uint8_t pan, int feedback, uint8_t kc, uint8_t *strobe_sh1)
+{
+    write_register(chip, 0x20 + channel, pan | (feedback ? 0x3C : 0x07), strobe_sh1); // FB 7 + connection 4, or 7
+    for (int op = 0; op < 4; op++)
+    {
+        uint8_t slot = (uint8_t)(op * 8 + channel);
+        int audible = feedback ? op < 2 : op == 3;
+        write_register(chip, 0x40 + slot, (uint8_t)(feedback ? 0x02 + op : 0x01), strobe_sh1); // MUL
+        write_register(chip, 0x60 + slot, audible ? (uint8_t)(op * 4) : 0x7F, strobe_sh1);    // TL
+        write_register(chip, 0x80 + slot, 0x1F, strobe_sh1);                                   // AR max
+        write_register(chip, 0xA0 + slot, 0x04, strobe_sh1);                                   // D1R
+        write_register(chip, 0xE0 + slot, 0x27, strobe_sh1);                                   // D1L 2, RR 7
+    }
+    write_register(chip, 0x28 + channel, kc, strobe_sh1);
+}
+
+static void compare_samples(opm_t *chip, uint8_t *strobe_sh1, uint32_t samples, int32_t *previous_sum,
+                            StemStats *stats)
+{
+    for (uint32_t n = 0; n < samples; n++)
+    {
+        int32_t output[2] = {0, 0};
+        int32_t stems[STEM_VALUES_PER_FRAME];
+        clock_sample(chip, output, strobe_sh1);
+        OPM_GetStems(chip, stems);
+        for (int side = 0; side < 2; side++)
+        {
+            int32_t sum = 0;
+            for (int ch = 0; ch < STEM_CHANNELS; ch++)
+            {
+                sum += stems[ch * 2 + side];
+            }
+            // Quantization step of the DAC's 10-bit mantissa (9 magnitude bits) at this level
+            int32_t magnitude = sum < 0 ? -sum : sum;
+            int32_t step = 1;
+            while (magnitude >= 512 * step)
+            {
+                step *= 2;
+            }
+            int32_t error = output[side] - sum;
+            error = error < 0 ? -error : error;
+            int32_t shifted = output[side] - previous_sum[side];
+            stats->frames++;
+            stats->sounding += sum != 0;
+            stats->over_bound += error >= 16 * step;
+            stats->error_sum += error;
+            stats->shifted_sum += shifted < 0 ? -shifted : shifted;
+            if (error > stats->worst_error)
+            {
+                stats->worst_error = error;
+                stats->worst_sum = sum;
+            }
+            previous_sum[side] = sum;
+        }
+    }
+}
+
+// Render the tones in one capture mode, returns 1 if the stems add up to the master
+static int run_mode(const char *name, uint8_t *strobe_sh1)
+{
+    opm_t *chip = (opm_t *)calloc(1, sizeof(opm_t));
+    if (!chip)
+    {
+        fprintf(stderr, "❌ Failed to allocate chip\n");
+        exit(1);
+    }
+    OPM_Reset(chip);
+    OPM_SetStemCapture(chip, 1);
+
+    set_patch(chip, 0, 0xC0, 0, 0x4A, strobe_sh1); // A4, both outputs
+    set_patch(chip, 1, 0x40, 0, 0x3E, strobe_sh1); // Left only
+    set_patch(chip, 2, 0x80, 0, 0x54, strobe_sh1); // Right only
+    set_patch(chip, 5, 0xC0, 1, 0x2A, strobe_sh1); // Feedback patch, both outputs
+    for (uint8_t ch = 0; ch < 8; ch++)
+    {
+        write_register(chip, 0x08, (uint8_t)(0x78 | ch), strobe_sh1); // Key on (unused channels stay silent)
+    }
+
+    StemStats stats = {0};
+    int32_t previous_sum[2] = {0, 0};
+    compare_samples(chip, strobe_sh1, TEST_SAMPLES, previous_sum, &stats);
+    write_register(chip, 0x08, 0x01, strobe_sh1); // Key off channel 1 and 2 (release)
+    write_register(chip, 0x08, 0x02, strobe_sh1);
+    compare_samples(chip, strobe_sh1, TEST_SAMPLES / 2, previous_sum, &stats);
+    write_register(chip, 0x08, 0x79, strobe_sh1); // Key channel 1 on again
+    compare_samples(chip, strobe_sh1, TEST_SAMPLES / 2, previous_sum, &stats);
+    free(chip);
+
+    double mean = stats.error_sum / stats.frames;
+    double shifted_mean = stats.shifted_sum / stats.frames;
+    printf("%s capture: %llu values (%llu sounding), mean |master - stem sum| %.2f (%.2f one sample off), "
+           "worst %d at %d\n",
+           name, (unsigned long long)stats.frames, (unsigned long long)stats.sounding, mean, shifted_mean,
+           stats.worst_error, stats.worst_sum);
+
+    int ok = 1;
+    if (stats.sounding < stats.frames / 2)
+    {
+        fprintf(stderr, "❌ %s capture: the test tones are silent\n", name);
+        ok = 0;
+    }
+    if (stats.over_bound)
+    {
+        fprintf(stderr, "❌ %s capture: %llu values differ from the stem sum by more than the DAC conversion\n", name,
+                (unsigned long long)stats.over_bound);
+        ok = 0;
+    }
+    if (mean * 4 > shifted_mean)
+    {
+        fprintf(stderr, "❌ %s capture: stems are not aligned with the master\n", name);
+        ok = 0;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    printf("Stem Capture Test\n");
+    printf("=================\n\n");
+
+    uint8_t strobe_sh1 = 0;
+    int ok = run_mode("Fixed", NULL);
+    ok = run_mode("Strobe", &strobe_sh1) && ok;
+    if (!ok)
+    {
+        return 1;
+    }
+    printf("\n✅ Test passed!\n");
+    return 0;
+}
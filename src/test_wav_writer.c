@@ -0,0 +1,212 @@
+/* Test for the streaming audio writer (wav_writer.h)
+ * Writes WAV (known and unknown length), RF64 and W64 files in every sample format, checks the header
+ * layout and sizes (including the fact chunk of float files), decodes them with the WAV decoder built
+ * into miniaudio (dr_wav) and checks that the samples match the converted PCM. The 4 GB RIFF limit is
+ * lowered to a few hundred KB so that the automatic switch to RF64 is exercised without writing 4 GB.
+ * Build: gcc -O2 -o test_wav_writer src/test_wav_writer.c opm.c -lm -lpthread -fwrapv
+ * Usage: ./test_wav_writer
+ */
+
+#define WAV_MAX_RIFF_SIZE 200000
+
+// Headless except for miniaudio's decoders (YM2151_HEADLESS would leave them out)
+#define MA_NO_DEVICE_IO
+#define MA_NO_ENCODING
+#define MA_NO_GENERATION
+#define MA_NO_RESOURCE_MANAGER
+#define MA_NO_NODE_GRAPH
+#define MA_NO_ENGINE
+#include "wav_writer.h"
+
+#define TEST_WAV_FILENAME "test_wav_writer_output.wav"
+
+typedef struct
+{
+    AudioContainer container;
+    int known_length;   // Pass the length to audio_writer_open (0 = unknown)
+    uint32_t frames;
+    const char *magic;  // First 4 bytes of the file
+    uint32_t header_bytes; // PCM header (float files add the fact chunk)
+} WriterCase;
+
+static const WriterCase cases[] = {
+    {CONTAINER_WAV, 1, 10000, "RIFF", WAV_HEADER_BYTES},       // Fits: plain 44-byte header
+    {CONTAINER_WAV, 0, 10000, "RIFF", WAV_DS64_HEADER_BYTES},  // Unknown length: JUNK chunk reserved, unused
+    {CONTAINER_WAV, 0, 60000, "RF64", WAV_DS64_HEADER_BYTES},  // Unknown length, passes the limit: RF64
+    {CONTAINER_WAV, 1, 60000, "RF64", WAV_DS64_HEADER_BYTES},  // Known to pass the limit: RF64
+    {CONTAINER_RF64, 1, 10001, "RF64", WAV_DS64_HEADER_BYTES}, // Forced RF64
+    {CONTAINER_W64, 1, 10001, "riff", W64_HEADER_BYTES},       // Odd length: data chunk padded to 8 bytes
+    {CONTAINER_W64, 0, 60000, "riff", W64_HEADER_BYTES},
+};
+
+static void generate_signal(int32_t *raw, uint32_t frames)
+{
+    uint32_t seed = 7;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        double t = (double)i / INTERNAL_SAMPLE_RATE;
+        raw[i * 2] = (int32_t)(30000 * sin(2 * M_PI * 440 * t)) + (int32_t)(seed >> 24) - 128;
+        raw[i * 2 + 1] = (int32_t)(40000 * sin(2 * M_PI * 330 * t)); // Beyond the 16-bit range
+    }
+}
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t read_u64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t header_bytes(const WriterCase *c, SampleFormat format)
+{
+    if (format != SAMPLE_FORMAT_F32)
+    {
+        return c->header_bytes;
+    }
+    return c->header_bytes + (c->container == CONTAINER_W64 ? W64_FLOAT_EXTRA_BYTES : WAV_FLOAT_EXTRA_BYTES);
+}
+
+// Check the size fields of the header against the file, returns 1 if they are consistent
+static int check_header(const WriterCase *c, SampleFormat format, const uint8_t *file, size_t file_size,
+                        uint64_t data_size)
+{
+    uint32_t header = header_bytes(c, format);
+    int is_float = format == SAMPLE_FORMAT_F32;
+    uint64_t frames = data_size / (2 * sample_format_bytes(format));
+    if (c->container == CONTAINER_W64)
+    {
+        // riff size (whole file), fmt chunk, fact chunk (float), data chunk size (header + data)
+        return read_u64(file + 16) == file_size && file_size == header + ((data_size + 7) & ~(uint64_t)7) &&
+               read_u64(file + 56) == (is_float ? 64u : 40u) && read_u64(file + header - 8) == 24 + data_size &&
+               (!is_float || (memcmp(file + 104, "fact", 4) == 0 && read_u64(file + 128) == frames));
+    }
+    if (file_size != header + data_size)
+    {
+        return 0;
+    }
+    // Float: 40-byte WAVE_FORMAT_EXTENSIBLE fmt chunk and a fact chunk with the frame count (0xFFFFFFFF in RF64)
+    int rf64 = memcmp(file, "RF64", 4) == 0;
+    if (is_float && (read_u32(file + header - 64) != 40 || memcmp(file + header - 20, "fact", 4) != 0 ||
+                     read_u32(file + header - 12) != (rf64 ? 0xFFFFFFFF : (uint32_t)frames)))
+    {
+        return 0;
+    }
+    if (rf64)
+    {
+        // Sizes in the ds64 chunk, 0xFFFFFFFF in the RIFF and data headers
+        return memcmp(file + 12, "ds64", 4) == 0 && read_u32(file + 4) == 0xFFFFFFFF &&
+               read_u64(file + 20) == file_size - 8 && read_u64(file + 28) == data_size &&
+               read_u64(file + 36) == frames && read_u32(file + header - 4) == 0xFFFFFFFF;
+    }
+    if (c->header_bytes == WAV_DS64_HEADER_BYTES && memcmp(file + 12, "JUNK", 4) != 0)
+    {
+        return 0;
+    }
+    return read_u32(file + 4) == file_size - 8 && read_u32(file + header - 4) == data_size;
+}
+
+// Decode the file in its own sample format, returns the number of frames decoded
+static ma_uint64 decode_file(const char *filename, SampleFormat format, uint8_t *out, ma_uint64 capacity)
+{
+    ma_format decoded_format = format == SAMPLE_FORMAT_F32 ? ma_format_f32
+                               : format == SAMPLE_FORMAT_S24 ? ma_format_s24
+                                                             : ma_format_s16;
+    ma_decoder_config config = ma_decoder_config_init(decoded_format, 2, 0);
+    ma_decoder decoder;
+    if (ma_decoder_init_file(filename, &config, &decoder) != MA_SUCCESS)
+    {
+        return 0;
+    }
+    ma_uint64 frames = 0;
+    ma_decoder_read_pcm_frames(&decoder, out, capacity, &frames);
+    ma_decoder_uninit(&decoder);
+    return frames;
+}
+
+// Write, check and decode one case, returns 1 if it passed
+static int run_case(const WriterCase *c, SampleFormat format)
+{
+    size_t bytes_per_frame = 2 * sample_format_bytes(format);
+    int32_t *raw = (int32_t *)malloc((size_t)c->frames * 2 * sizeof(int32_t));
+    uint8_t *pcm = (uint8_t *)malloc((size_t)c->frames * bytes_per_frame);
+    uint8_t *decoded = (uint8_t *)malloc(((size_t)c->frames + 16) * bytes_per_frame);
+    generate_signal(raw, c->frames);
+    convert_samples(format, raw, pcm, (size_t)c->frames * 2);
+
+    // Written in uneven pieces like the render blocks
+    AudioWriter *writer = audio_writer_open(TEST_WAV_FILENAME, format, INTERNAL_SAMPLE_RATE, c->container,
+                                            c->known_length ? c->frames : 0);
+    int ok = writer != NULL;
+    for (uint32_t i = 0; writer && i < c->frames; i += 777)
+    {
+        uint32_t count = c->frames - i < 777 ? c->frames - i : 777;
+        audio_writer_write(writer, pcm + (size_t)i * bytes_per_frame, count);
+    }
+    ok = ok && audio_writer_close(writer, TEST_WAV_FILENAME);
+
+    size_t file_size = 0;
+    uint8_t *file = NULL;
+    FILE *fp = fopen(TEST_WAV_FILENAME, "rb");
+    if (fp)
+    {
+        fseek(fp, 0, SEEK_END);
+        file_size = (size_t)ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        file = (uint8_t *)malloc(file_size);
+        file_size = fread(file, 1, file_size, fp);
+        fclose(fp);
+    }
+    uint64_t data_size = (uint64_t)c->frames * bytes_per_frame;
+    uint32_t header = header_bytes(c, format);
+    ok = ok && file && file_size >= header && memcmp(file, c->magic, 4) == 0 &&
+         check_header(c, format, file, file_size, data_size) && memcmp(file + header, pcm, (size_t)data_size) == 0;
+
+    ma_uint64 frames = ok ? decode_file(TEST_WAV_FILENAME, format, decoded, (ma_uint64)c->frames + 16) : 0;
+    ok = ok && frames == c->frames && memcmp(decoded, pcm, (size_t)data_size) == 0;
+    if (!ok)
+    {
+        fprintf(stderr, "❌ %s container %d, %s length, %u frames, %s: header or samples differ\n", c->magic,
+                c->container, c->known_length ? "known" : "unknown", c->frames, sample_format_name(format));
+    }
+    remove(TEST_WAV_FILENAME);
+    free(file);
+    free(raw);
+    free(pcm);
+    free(decoded);
+    return ok;
+}
+
+int main(void)
+{
+    printf("Audio Writer Test\n");
+    printf("=================\n\n");
+
+    static const SampleFormat formats[] = {SAMPLE_FORMAT_S16, SAMPLE_FORMAT_S16_CLIP, SAMPLE_FORMAT_S24,
+                                           SAMPLE_FORMAT_F32};
+    int failures = 0;
+    int runs = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+        {
+            failures += !run_case(&cases[i], formats[f]);
+            runs++;
+        }
+    }
+    if (failures)
+    {
+        fprintf(stderr, "\n❌ %d of %d files failed\n", failures, runs);
+        return 1;
+    }
+    printf("\n✅ %d WAV, RF64 and W64 files decode to the written samples\n", runs);
+    printf("\n✅ Test passed!\n");
+    return 0;
+}
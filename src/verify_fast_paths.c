@@ -0,0 +1,140 @@
+/* Equivalence check for the emulator fast paths (OPM_SetFastPaths)
+ * Renders each log twice in lockstep, once with all fast paths disabled (reference) and once with
+ * them enabled, and checks that every output sample and the complete chip state are identical.
+ * Also reports the emulation time of both chips. A log whose reference output is all zero fails, since
+ * silence only exercises the fast paths of idle slots (see test_logs/ for sounding logs).
+ * Build: gcc -O2 -o verify_fast_paths src/verify_fast_paths.c opm.c -lm -lpthread -fwrapv
+ * Usage: ./verify_fast_paths <json_log_file>...
+ */
+
+#define YM2151_HEADLESS // No audio device: emulation, threads and file IO only
+#include "core.h"
+
+#define STATE_CHECK_INTERVAL 64 // Samples between full chip state comparisons
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Compare the complete chip state, ignoring the fast path selection itself
+static int same_chip_state(const opm_t *reference, const opm_t *fast)
+{
+    opm_t copy = *fast;
+    copy.fast_paths = reference->fast_paths;
+    return memcmp(reference, &copy, sizeof(opm_t)) == 0;
+}
+
+// Clock one sample and return the emulation time in ms
+static double clock_one_sample(AudioContext *ctx, uint32_t sample, int32_t *output)
+{
+    double start = now_ms();
+    process_events_until(ctx, sample);
+    for (int i = 0; i < CYCLES_PER_SAMPLE; i++)
+    {
+        OPM_Clock(&ctx->chip, output, NULL, NULL, NULL);
+    }
+    return now_ms() - start;
+}
+
+// Render one log with and without fast paths, returns 1 if bit-identical
+static int verify_log(const char *filename)
+{
+    printf("%s\n", filename);
+    RegisterEventList *pass1 = load_events_json_pass1(filename);
+    if (!pass1)
+    {
+        return 0;
+    }
+    RegisterEventList *pass2 = split_pass1_events(pass1);
+    uint32_t samples = INTERNAL_SAMPLE_RATE;
+    for (size_t i = 0; i < pass2->count; i++)
+    {
+        if (pass2->events[i].sample_time + INTERNAL_SAMPLE_RATE > samples)
+        {
+            samples = pass2->events[i].sample_time + INTERNAL_SAMPLE_RATE;
+        }
+    }
+
+    AudioContext *reference = (AudioContext *)calloc(1, sizeof(AudioContext));
+    AudioContext *fast = (AudioContext *)calloc(1, sizeof(AudioContext));
+    if (!reference || !fast)
+    {
+        fprintf(stderr, "❌ Failed to allocate render contexts\n");
+        exit(1);
+    }
+    OPM_Reset(&reference->chip);
+    OPM_SetFastPaths(&reference->chip, 0);
+    OPM_Reset(&fast->chip);
+    OPM_SetFastPaths(&fast->chip, OPM_FAST_ALL);
+    reference->events = pass2;
+    fast->events = pass2;
+
+    double reference_ms = 0.0;
+    double fast_ms = 0.0;
+    uint32_t sounding = 0; // Reference samples with a non-zero output
+    int ok = 1;
+    for (uint32_t i = 0; i < samples && ok; i++)
+    {
+        int32_t out_reference[2] = {0, 0};
+        int32_t out_fast[2] = {0, 0};
+        reference_ms += clock_one_sample(reference, i, out_reference);
+        fast_ms += clock_one_sample(fast, i, out_fast);
+        sounding += out_reference[0] != 0 || out_reference[1] != 0;
+        if (out_reference[0] != out_fast[0] || out_reference[1] != out_fast[1])
+        {
+            fprintf(stderr, "❌ Output differs at sample %u (%.3f s)\n", i, (double)i / INTERNAL_SAMPLE_RATE);
+            ok = 0;
+        }
+        else if ((i % STATE_CHECK_INTERVAL == 0 || i + 1 == samples) && !same_chip_state(&reference->chip, &fast->chip))
+        {
+            fprintf(stderr, "❌ Chip state differs at sample %u (%.3f s)\n", i, (double)i / INTERNAL_SAMPLE_RATE);
+            ok = 0;
+        }
+    }
+
+    if (ok && sounding == 0)
+    {
+        fprintf(stderr, "❌ Reference output is silent, the log does not exercise the fast paths\n");
+        ok = 0;
+    }
+    if (ok)
+    {
+        printf("  ✅ %u samples bit-identical (output and chip state), %u sounding\n", samples, sounding);
+        printf("  Emulation: reference %.1f ms, fast paths %.1f ms (%.2fx)\n", reference_ms, fast_ms,
+               fast_ms > 0 ? reference_ms / fast_ms : 0.0);
+    }
+    free(reference);
+    free(fast);
+    free_event_list(pass2);
+    free_event_list(pass1);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    printf("Fast Path Equivalence Check\n");
+    printf("===========================\n\n");
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <json_log_file>...\n", argv[0]);
+        return 1;
+    }
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        failures += !verify_log(argv[i]);
+    }
+
+    if (failures)
+    {
+        fprintf(stderr, "\n❌ %d of %d logs failed the fast path check\n", failures, argc - 1);
+        return 1;
+    }
+    printf("\n✅ Fast paths are bit-exact\n");
+    return 0;
+}
@@ -0,0 +1,230 @@
+/* Equivalence check for redundant register write elimination
+ * 1. Replays the original and the optimized pass1 events through a shadow register file and checks that
+ *    every register holds the same value at the end of each time group.
+ * 2. Renders the original and the optimized writes at their original pass2 times: the output must be
+ *    bit-identical, which shows that every dropped write was a no-op for the emulator.
+ * 3. Renders the optimized events with their own (tighter) pass2 timing and reports the difference.
+ * Build: gcc -O2 -o verify_optimizer src/verify_optimizer.c opm.c -lm -lpthread -fwrapv
+ * Usage: ./verify_optimizer <json_log_file>
+ */
+
+#define YM2151_HEADLESS // No audio device: emulation, threads and file IO only
+#include "core.h"
+#include "event_optimizer.h"
+
+#define SHADOW_PMD 256 // 0x19 holds AMD or PMD depending on bit 7
+
+// Apply one write to a shadow register file (-1 = never written)
+static void shadow_write(int16_t *shadow, const RegisterEvent *event)
+{
+    if (event->address == 0x19 && (event->data & 0x80))
+    {
+        shadow[SHADOW_PMD] = event->data;
+    }
+    else
+    {
+        shadow[event->address] = event->data;
+    }
+}
+
+// Compare register contents after every group of writes with the same time, returns number of mismatches
+// kept[i] is set for each original event that is also in the optimized list
+static size_t check_register_state(RegisterEventList *original, RegisterEventList *optimized, uint8_t *kept,
+                                   size_t *groups)
+{
+    int16_t shadow_original[257];
+    int16_t shadow_optimized[257];
+    memset(shadow_original, 0xff, sizeof(shadow_original));
+    memset(shadow_optimized, 0xff, sizeof(shadow_optimized));
+
+    size_t j = 0;
+    size_t mismatches = 0;
+    *groups = 0;
+    for (size_t i = 0; i < original->count; i++)
+    {
+        RegisterEvent *event = &original->events[i];
+        shadow_write(shadow_original, event);
+        kept[i] = 0;
+
+        // The optimized list is a subsequence of the original one
+        if (j < optimized->count && optimized->events[j].sample_time == event->sample_time &&
+            optimized->events[j].address == event->address && optimized->events[j].data == event->data)
+        {
+            shadow_write(shadow_optimized, &optimized->events[j]);
+            kept[i] = 1;
+            j++;
+        }
+
+        if (i + 1 == original->count || original->events[i + 1].sample_time != event->sample_time)
+        {
+            (*groups)++;
+            if (memcmp(shadow_original, shadow_optimized, sizeof(shadow_original)) != 0)
+            {
+                if (mismatches == 0)
+                {
+                    fprintf(stderr, "❌ Register state differs after time %u (event %zu)\n", event->sample_time, i);
+                }
+                mismatches++;
+            }
+        }
+    }
+    if (j != optimized->count)
+    {
+        fprintf(stderr, "❌ Optimized list is not a subsequence of the original (%zu of %zu matched)\n", j,
+                optimized->count);
+        mismatches++;
+    }
+    return mismatches;
+}
+
+// Render pass2 events offline with the same event timing and clocking as the audio callback
+static int32_t *render_pass2(RegisterEventList *pass2, uint32_t samples)
+{
+    AudioContext *ctx = (AudioContext *)calloc(1, sizeof(AudioContext));
+    int32_t *out = (int32_t *)malloc((size_t)samples * 2 * sizeof(int32_t));
+    if (!ctx || !out)
+    {
+        fprintf(stderr, "❌ Failed to allocate render buffers\n");
+        exit(1);
+    }
+
+    OPM_Reset(&ctx->chip);
+    ctx->events = pass2;
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        process_events_until(ctx, i);
+        int32_t output[2] = {0, 0};
+        for (int j = 0; j < CYCLES_PER_SAMPLE; j++)
+        {
+            OPM_Clock(&ctx->chip, output, NULL, NULL, NULL);
+        }
+        out[i * 2] = output[0];
+        out[i * 2 + 1] = output[1];
+    }
+
+    free(ctx);
+    return out;
+}
+
+// Compare two renders, returns 1 if bit-identical
+static int compare_renders(const int32_t *a, const int32_t *b, uint32_t samples)
+{
+    size_t identical = 0;
+    size_t first_diff = SIZE_MAX;
+    int32_t max_diff = 0;
+    double signal_energy = 0.0;
+    double diff_energy = 0.0;
+    for (size_t i = 0; i < (size_t)samples * 2; i++)
+    {
+        int32_t diff = a[i] - b[i];
+        if (diff == 0)
+        {
+            identical++;
+        }
+        else if (first_diff == SIZE_MAX)
+        {
+            first_diff = i / 2;
+        }
+        max_diff = abs(diff) > max_diff ? abs(diff) : max_diff;
+        signal_energy += (double)a[i] * a[i];
+        diff_energy += (double)diff * diff;
+    }
+
+    printf("  Identical values: %zu / %zu\n", identical, (size_t)samples * 2);
+    if (first_diff == SIZE_MAX)
+    {
+        printf("  ✅ Output is bit-identical\n");
+        return 1;
+    }
+    printf("  First difference at sample %zu (%.3f s), max difference %d\n", first_diff,
+           (double)first_diff / INTERNAL_SAMPLE_RATE, max_diff);
+    printf("  Difference energy: %.1f dB relative to signal\n",
+           diff_energy > 0 && signal_energy > 0 ? 10.0 * log10(diff_energy / signal_energy) : 0.0);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    printf("Redundant Write Elimination Check\n");
+    printf("=================================\n\n");
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <json_log_file>\n", argv[0]);
+        return 1;
+    }
+
+    RegisterEventList *original = load_events_json_pass1(argv[1]);
+    if (!original)
+    {
+        return 1;
+    }
+    RegisterEventList *optimized = optimize_redundant_writes(original);
+
+    uint8_t *kept = (uint8_t *)malloc(original->count ? original->count : 1);
+    if (!kept)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory\n");
+        return 1;
+    }
+    size_t groups;
+    size_t mismatches = check_register_state(original, optimized, kept, &groups);
+    printf("Register state: %zu time groups compared, %zu mismatches\n\n", groups, mismatches);
+
+    // Pass2 events: original, optimized writes at the original times, optimized with its own timing
+    RegisterEventList *pass2_original = convert_to_pass2_format(original);
+    RegisterEventList *pass2_same_timing = create_event_list();
+    for (size_t i = 0; i < original->count; i++)
+    {
+        if (kept[i])
+        {
+            RegisterEvent *addr_event = &pass2_original->events[i * 2];
+            RegisterEvent *data_event = &pass2_original->events[i * 2 + 1];
+            add_event_with_flag(pass2_same_timing, addr_event->sample_time, addr_event->address, addr_event->data, 0);
+            add_event_with_flag(pass2_same_timing, data_event->sample_time, data_event->address, data_event->data, 1);
+        }
+    }
+    RegisterEventList *pass2_optimized = convert_to_pass2_format(optimized);
+
+    // Render for the length of the original plus one second
+    uint32_t samples = INTERNAL_SAMPLE_RATE;
+    for (size_t i = 0; i < pass2_original->count; i++)
+    {
+        if (pass2_original->events[i].sample_time + INTERNAL_SAMPLE_RATE > samples)
+        {
+            samples = pass2_original->events[i].sample_time + INTERNAL_SAMPLE_RATE;
+        }
+    }
+    int32_t *audio_original = render_pass2(pass2_original, samples);
+    int32_t *audio_same_timing = render_pass2(pass2_same_timing, samples);
+    int32_t *audio_optimized = render_pass2(pass2_optimized, samples);
+
+    printf("Optimized writes at the original times (%u samples):\n", samples);
+    if (!compare_renders(audio_original, audio_same_timing, samples))
+    {
+        mismatches++;
+    }
+
+    // Dropped writes shorten the spacing of the writes that follow them in the same burst,
+    // so those reach the chip a few samples earlier: the waveforms are shifted, not identical
+    printf("\nOptimized writes with compacted timing (informational):\n");
+    compare_renders(audio_original, audio_optimized, samples);
+
+    free(audio_same_timing);
+    free_event_list(pass2_original);
+    free_event_list(pass2_same_timing);
+    free_event_list(pass2_optimized);
+    free(kept);
+    free(audio_original);
+    free(audio_optimized);
+    free_event_list(optimized);
+    free_event_list(original);
+
+    if (mismatches)
+    {
+        fprintf(stderr, "\n❌ Optimized events are not equivalent\n");
+        return 1;
+    }
+    printf("\n✅ Optimized events are equivalent\n");
+    return 0;
+}
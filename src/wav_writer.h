@@ -1,51 +1,411 @@
-#include "types.h"
+#ifndef WAV_WRITER_H
+#define WAV_WRITER_H
 
-// Save WAV file
-int save_wav_file(const char *filename, int32_t *buffer, uint32_t num_samples)
+#include "flac_encoder.h"
+#include "sample_convert.h"
+
+// Audio file output
+// AudioWriter streams converted frames to a file: the header is written with zero sizes when the file is
+// opened and patched when it is closed, so nothing but one block is held in memory however long the
+// recording is. WAV files whose size is unknown or may pass 4 GB get a JUNK chunk after the RIFF header;
+// if the file does pass 4 GB, the header is rewritten as RF64 (EBU Tech 3306) and the JUNK chunk becomes
+// the ds64 chunk with the 64-bit sizes. Files of a known size that fit keep the plain 44-byte header.
+// W64 (Sony Wave64) always has 64-bit sizes. FLAC output goes to the encoder thread (flac_encoder.h).
+// Float (f32) files use WAVE_FORMAT_EXTENSIBLE (IEEE float subformat) and a fact chunk with the frame count.
+
+// Container of the saved audio files
+typedef enum
+{
+    CONTAINER_WAV = 0, // RIFF WAVE, becomes RF64 if the file passes 4 GB
+    CONTAINER_FLAC,    // Lossless compressed, integer sample formats only (see flac_encoder.h)
+    CONTAINER_RF64,    // RF64 (EBU Tech 3306) from the start: 64-bit sizes in a ds64 chunk
+    CONTAINER_W64      // Sony Wave64: GUID chunk IDs and 64-bit sizes
+} AudioContainer;
+
+// Streaming writer for saved audio files (wav_writer.h)
+typedef struct
+{
+    AudioContainer container;
+    SampleFormat format;      // Layout of the frames passed to audio_writer_write
+    uint32_t sample_rate;
+    FILE *fp;                 // WAV, RF64 and W64 output (NULL with FLAC)
+    FlacEncoder *flac;        // FLAC output (NULL otherwise)
+    int reserve_ds64;         // WAV: the header has room for a ds64 chunk (JUNK until the file passes 4 GB)
+    int rf64;                 // Header was last written as RF64
+    int oversized;            // WAV past 4 GB without room for ds64: sizes clamped
+    uint64_t frames;          // Frames written
+    int write_failed;
+} AudioWriter;
+
+// WAV file structures
+typedef struct
+{
+    char riff[4];
+    uint32_t file_size;
+    char wave[4];
+} WAVHeader;
+
+typedef struct
+{
+    char fmt[4];
+    uint32_t chunk_size;
+    uint16_t audio_format;
+    uint16_t num_channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+} FMTChunk;
+
+typedef struct
+{
+    char data[4];
+    uint32_t data_size;
+} DATAChunk;
+
+// WAVE_FORMAT_EXTENSIBLE fields of a float fmt chunk (40 bytes), after the 16 bytes of FMTChunk
+typedef struct
+{
+    uint16_t cb_size; // 22
+    uint16_t valid_bits_per_sample;
+    uint32_t channel_mask;
+    uint8_t sub_format[16];
+} FMTExtension;
+
+// Sample frames of a non-PCM (float) file
+typedef struct
+{
+    char fact[4];
+    uint32_t chunk_size; // 4
+    uint32_t sample_count;
+} FACTChunk;
+
+// RF64 sizes (the RIFF and data size fields hold 0xFFFFFFFF), written as a JUNK chunk of the same size
+// while the file fits a RIFF header
+typedef struct
+{
+    char ds64[4];
+    uint32_t chunk_size; // 28 (the struct is padded to 40 bytes, only 36 are written)
+    uint64_t riff_size;
+    uint64_t data_size;
+    uint64_t sample_count;
+    uint32_t table_length;
+} DS64Chunk;
+
+// Wave64 chunk header (chunk sizes include the header, chunks are 8-byte aligned)
+typedef struct
+{
+    uint8_t guid[16];
+    uint64_t size;
+} W64ChunkHeader;
+
+#define WAV_HEADER_BYTES 44      // RIFF + fmt + data headers (PCM)
+#define WAV_DS64_HEADER_BYTES 80 // With a ds64 (or JUNK) chunk
+#define W64_HEADER_BYTES 104     // riff + wave GUID + fmt + data headers (PCM)
+#define WAV_FLOAT_EXTRA_BYTES 36 // f32: FMTExtension and a fact chunk
+#define W64_FLOAT_EXTRA_BYTES 56 // f32: FMTExtension and a 32-byte fact chunk
+#ifndef WAV_MAX_RIFF_SIZE
+#define WAV_MAX_RIFF_SIZE 0xFFFFFFFFULL // Largest RIFF size field (test_wav_writer lowers it)
+#endif
+
+// Wave64 chunk GUIDs
+static const uint8_t W64_GUID_RIFF[16] = {'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11,
+                                          0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00};
+static const uint8_t W64_GUID_WAVE[16] = {'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11,
+                                          0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+static const uint8_t W64_GUID_FMT[16] = {'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11,
+                                         0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+static const uint8_t W64_GUID_DATA[16] = {'d', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11,
+                                          0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+static const uint8_t W64_GUID_FACT[16] = {'f', 'a', 'c', 't', 0xF3, 0xAC, 0xD3, 0x11,
+                                          0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+
+// KSDATAFORMAT_SUBTYPE_IEEE_FLOAT
+static const uint8_t WAV_SUBFORMAT_FLOAT[16] = {0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+                                                0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+const char *container_extension(AudioContainer container)
+{
+    return container == CONTAINER_FLAC ? "flac" : container == CONTAINER_W64 ? "w64" : "wav";
+}
+
+// Bytes before the sample data
+static uint32_t audio_header_bytes(const AudioWriter *writer)
 {
-    FILE *fp = fopen(filename, "wb");
-    if (!fp)
+    int is_float = writer->format == SAMPLE_FORMAT_F32;
+    if (writer->container == CONTAINER_W64)
     {
-        fprintf(stderr, "❌ Failed to open %s for writing\n", filename);
-        return 0;
+        return W64_HEADER_BYTES + (is_float ? W64_FLOAT_EXTRA_BYTES : 0);
     }
+    return (writer->reserve_ds64 ? WAV_DS64_HEADER_BYTES : WAV_HEADER_BYTES) + (is_float ? WAV_FLOAT_EXTRA_BYTES : 0);
+}
 
-    uint32_t data_size = num_samples * 2 * sizeof(int16_t);
+// Stereo fmt chunk for the given sample format (f32: 40 bytes, an FMTExtension follows the struct)
+static FMTChunk wav_fmt_chunk(SampleFormat format, uint32_t sample_rate)
+{
+    uint32_t bytes_per_value = sample_format_bytes(format);
+    FMTChunk fmt;
+    memcpy(fmt.fmt, "fmt ", 4);
+    fmt.chunk_size = format == SAMPLE_FORMAT_F32 ? 16 + sizeof(FMTExtension) : 16;
+    fmt.audio_format = format == SAMPLE_FORMAT_F32 ? 0xFFFE : 1; // WAVE_FORMAT_EXTENSIBLE or PCM
+    fmt.num_channels = 2;                                        // Stereo
+    fmt.sample_rate = sample_rate;
+    fmt.byte_rate = sample_rate * 2 * bytes_per_value;
+    fmt.block_align = 2 * bytes_per_value;
+    fmt.bits_per_sample = bytes_per_value * 8;
+    return fmt;
+}
+
+// Extension of the float fmt chunk: front left and right, IEEE float subformat
+static FMTExtension wav_float_extension(void)
+{
+    FMTExtension ext;
+    ext.cb_size = sizeof(FMTExtension) - 2;
+    ext.valid_bits_per_sample = 32;
+    ext.channel_mask = 0x3;
+    memcpy(ext.sub_format, WAV_SUBFORMAT_FLOAT, 16);
+    return ext;
+}
+
+// Wave64 header for the frames written so far (the data is padded to 8 bytes at close)
+static int write_w64_header(AudioWriter *writer, uint64_t data_size)
+{
+    FMTChunk fmt = wav_fmt_chunk(writer->format, writer->sample_rate);
+    FMTExtension ext = wav_float_extension();
+    int is_float = writer->format == SAMPLE_FORMAT_F32;
+    W64ChunkHeader riff, fmt_header, fact, data;
+    memcpy(riff.guid, W64_GUID_RIFF, 16);
+    riff.size = audio_header_bytes(writer) + ((data_size + 7) & ~(uint64_t)7);
+    memcpy(fmt_header.guid, W64_GUID_FMT, 16);
+    fmt_header.size = sizeof(W64ChunkHeader) + fmt.chunk_size; // 16 or 40: no padding
+    memcpy(fact.guid, W64_GUID_FACT, 16);
+    fact.size = sizeof(W64ChunkHeader) + 8;
+    uint64_t sample_count = writer->frames;
+    memcpy(data.guid, W64_GUID_DATA, 16);
+    data.size = sizeof(W64ChunkHeader) + data_size;
+
+    FILE *fp = writer->fp;
+    return fwrite(&riff, sizeof(riff), 1, fp) == 1 && fwrite(W64_GUID_WAVE, 16, 1, fp) == 1 &&
+           fwrite(&fmt_header, sizeof(fmt_header), 1, fp) == 1 && fwrite(&fmt.audio_format, 16, 1, fp) == 1 &&
+           (!is_float || (fwrite(&ext, sizeof(ext), 1, fp) == 1 && fwrite(&fact, sizeof(fact), 1, fp) == 1 &&
+                          fwrite(&sample_count, sizeof(sample_count), 1, fp) == 1)) &&
+           fwrite(&data, sizeof(data), 1, fp) == 1;
+}
+
+// WAV or RF64 header for the frames written so far
+static int write_wav_header(AudioWriter *writer, uint64_t data_size)
+{
+    uint64_t riff_size = audio_header_bytes(writer) - 8 + data_size;
+    writer->rf64 = writer->container == CONTAINER_RF64 || (writer->reserve_ds64 && riff_size > WAV_MAX_RIFF_SIZE);
+    writer->oversized = !writer->reserve_ds64 && riff_size > WAV_MAX_RIFF_SIZE;
 
     // Write WAV header
     WAVHeader header;
-    memcpy(header.riff, "RIFF", 4);
-    header.file_size = data_size + 36;
+    memcpy(header.riff, writer->rf64 ? "RF64" : "RIFF", 4);
+    header.file_size = writer->rf64 || writer->oversized ? 0xFFFFFFFF : (uint32_t)riff_size;
     memcpy(header.wave, "WAVE", 4);
-    fwrite(&header, sizeof(WAVHeader), 1, fp);
 
-    // Write FMT chunk
-    FMTChunk fmt;
-    memcpy(fmt.fmt, "fmt ", 4);
-    fmt.chunk_size = 16;
-    fmt.audio_format = 1; // PCM
-    fmt.num_channels = 2; // Stereo
-    fmt.sample_rate = INTERNAL_SAMPLE_RATE;
-    fmt.byte_rate = INTERNAL_SAMPLE_RATE * 2 * sizeof(int16_t);
-    fmt.block_align = 2 * sizeof(int16_t);
-    fmt.bits_per_sample = 16;
-    fwrite(&fmt, sizeof(FMTChunk), 1, fp);
+    // ds64 chunk, or a JUNK chunk keeping its place
+    DS64Chunk ds64;
+    memset(&ds64, 0, sizeof(ds64));
+    memcpy(ds64.ds64, writer->rf64 ? "ds64" : "JUNK", 4);
+    ds64.chunk_size = 28;
+    if (writer->rf64)
+    {
+        ds64.riff_size = riff_size;
+        ds64.data_size = data_size;
+        ds64.sample_count = writer->frames;
+    }
+
+    // Float: fmt chunk extension and frame count
+    FMTChunk fmt = wav_fmt_chunk(writer->format, writer->sample_rate);
+    FMTExtension ext = wav_float_extension();
+    int is_float = writer->format == SAMPLE_FORMAT_F32;
+    FACTChunk fact;
+    memcpy(fact.fact, "fact", 4);
+    fact.chunk_size = 4;
+    fact.sample_count = writer->rf64 || writer->frames > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)writer->frames;
 
     // Write DATA chunk header
     DATAChunk data;
     memcpy(data.data, "data", 4);
-    data.data_size = data_size;
-    fwrite(&data, sizeof(DATAChunk), 1, fp);
+    data.data_size = writer->rf64 || writer->oversized ? 0xFFFFFFFF : (uint32_t)data_size;
 
-    // Write audio data (convert 32-bit to 16-bit)
-    for (uint32_t i = 0; i < num_samples * 2; i++)
+    FILE *fp = writer->fp;
+    return fwrite(&header, sizeof(WAVHeader), 1, fp) == 1 &&
+           (!writer->reserve_ds64 || fwrite(&ds64, 8 + ds64.chunk_size, 1, fp) == 1) &&
+           fwrite(&fmt, sizeof(FMTChunk), 1, fp) == 1 &&
+           (!is_float || (fwrite(&ext, sizeof(ext), 1, fp) == 1 && fwrite(&fact, sizeof(FACTChunk), 1, fp) == 1)) &&
+           fwrite(&data, sizeof(DATAChunk), 1, fp) == 1;
+}
+
+static int write_audio_header(AudioWriter *writer)
+{
+    uint64_t data_size = writer->frames * 2 * sample_format_bytes(writer->format);
+    return writer->container == CONTAINER_W64 ? write_w64_header(writer, data_size)
+                                              : write_wav_header(writer, data_size);
+}
+
+// Open a streaming writer, returns NULL on failure (reported)
+// expected_frames: length if known in advance (0 = unknown); a WAV file that may pass 4 GB reserves room for RF64
+AudioWriter *audio_writer_open(const char *filename, SampleFormat format, uint32_t sample_rate,
+                               AudioContainer container, uint64_t expected_frames)
+{
+    AudioWriter *writer = (AudioWriter *)calloc(1, sizeof(AudioWriter));
+    if (!writer)
     {
-        // Divide by 2 to convert from 32-bit to 16-bit range
-        int16_t sample = (int16_t)(buffer[i] / 2);
-        fwrite(&sample, sizeof(int16_t), 1, fp);
+        fprintf(stderr, "❌ Failed to allocate audio writer\n");
+        return NULL;
     }
+    writer->container = container;
+    writer->format = format;
+    writer->sample_rate = sample_rate;
 
-    fclose(fp);
-    printf("✅ Saved WAV file: %s\n", filename);
+    if (container == CONTAINER_FLAC)
+    {
+        writer->flac = flac_encoder_open(filename, format, sample_rate);
+        if (!writer->flac)
+        {
+            free(writer);
+            return NULL;
+        }
+        return writer;
+    }
+
+    writer->fp = fopen(filename, "wb");
+    if (!writer->fp)
+    {
+        fprintf(stderr, "❌ Failed to open %s for writing\n", filename);
+        free(writer);
+        return NULL;
+    }
+    // RIFF size with the plain header (reserve_ds64 is still 0)
+    uint64_t expected_size = audio_header_bytes(writer) - 8 + expected_frames * 2 * sample_format_bytes(format);
+    writer->reserve_ds64 = container == CONTAINER_RF64 ||
+                           (container == CONTAINER_WAV && (expected_frames == 0 || expected_size > WAV_MAX_RIFF_SIZE));
+    writer->write_failed = !write_audio_header(writer); // Sizes are patched at close
+    return writer;
+}
+
+// Append frames in the writer's sample format
+void audio_writer_write(AudioWriter *writer, const uint8_t *data, size_t frames)
+{
+    size_t bytes_per_frame = 2 * sample_format_bytes(writer->format);
+    if (writer->flac)
+    {
+        flac_encoder_write(writer->flac, data, frames);
+    }
+    else if (!writer->write_failed && fwrite(data, bytes_per_frame, frames, writer->fp) != frames)
+    {
+        writer->write_failed = 1;
+    }
+    writer->frames += frames;
+}
+
+// Patch the header and close the file (FLAC: wait for the encoder), frees the writer, returns 0 on failure
+int audio_writer_close(AudioWriter *writer, const char *filename)
+{
+    if (writer->flac)
+    {
+        int ok = flac_encoder_close(writer->flac, filename);
+        free(writer);
+        return ok;
+    }
+
+    int ok = !writer->write_failed;
+    if (writer->container == CONTAINER_W64)
+    {
+        // Chunks are 8-byte aligned, pad the data chunk
+        static const uint8_t padding[8] = {0};
+        size_t pad = (size_t)(-(writer->frames * 2 * sample_format_bytes(writer->format)) & 7);
+        ok = ok && fwrite(padding, 1, pad, writer->fp) == pad;
+    }
+    ok = ok && fseek(writer->fp, 0, SEEK_SET) == 0 && write_audio_header(writer);
+    ok = fclose(writer->fp) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "❌ Failed to write %s\n", filename);
+    }
+    else
+    {
+        const char *name = writer->container == CONTAINER_W64 ? "W64" : writer->rf64 ? "RF64" : "WAV";
+        printf("✅ Saved %s file: %s (%s)\n", name, filename, sample_format_name(writer->format));
+        if (writer->oversized)
+        {
+            printf("⚠️  %s is larger than 4 GB but has no room for RF64 sizes: size fields clamped\n", filename);
+        }
+    }
+    free(writer);
+    return ok;
+}
+
+// Save a recording (int32 DAC values) as WAV, RF64, W64 or FLAC
+int save_audio_file(const char *filename, const int32_t *buffer, uint32_t num_samples, SampleFormat format,
+                    AudioContainer container)
+{
+    AudioWriter *writer = audio_writer_open(filename, format, INTERNAL_SAMPLE_RATE, container, num_samples);
+    if (!writer)
+    {
+        return 0;
+    }
+
+    // Write audio data (convert 32-bit DAC output block by block)
+    uint8_t block[INTERNAL_BUFFER_SIZE * 2 * 4];
+    size_t total_values = (size_t)num_samples * 2;
+    for (size_t i = 0; i < total_values; i += INTERNAL_BUFFER_SIZE * 2)
+    {
+        size_t count = total_values - i;
+        if (count > INTERNAL_BUFFER_SIZE * 2)
+        {
+            count = INTERNAL_BUFFER_SIZE * 2;
+        }
+        convert_samples(format, buffer + i, block, count);
+        audio_writer_write(writer, block, count / 2);
+    }
+    return audio_writer_close(writer, filename);
+}
+
+// Save one stereo file per non-silent channel (output_ch1.wav .. output_ch8.wav, or .w64/.flac)
+// Stem frame n holds the mixer sums of the sample the DAC outputs in master frame n, so the stems add up
+// to the master up to the DAC's floating point conversion (see test_stems.c).
+int save_stem_files(const char *prefix, const int32_t *stems, uint32_t num_samples, SampleFormat format,
+                    AudioContainer container)
+{
+    int32_t *buffer = (int32_t *)malloc(((size_t)num_samples * 2 + 1) * sizeof(int32_t));
+    if (!buffer)
+    {
+        fprintf(stderr, "❌ Failed to allocate stem buffer\n");
+        return 0;
+    }
+
+    int saved = 0;
+    for (int ch = 0; ch < STEM_CHANNELS; ch++)
+    {
+        int silent = 1;
+        for (uint32_t i = 0; i < num_samples; i++)
+        {
+            buffer[i * 2] = stems[(size_t)i * STEM_VALUES_PER_FRAME + ch * 2];
+            buffer[i * 2 + 1] = stems[(size_t)i * STEM_VALUES_PER_FRAME + ch * 2 + 1];
+            silent &= buffer[i * 2] == 0 && buffer[i * 2 + 1] == 0;
+        }
+        if (silent)
+        {
+            continue;
+        }
+
+        char filename[256];
+        snprintf(filename, sizeof(filename), "%s_ch%d.%s", prefix, ch + 1, container_extension(container));
+        if (!save_audio_file(filename, buffer, num_samples, format, container))
+        {
+            free(buffer);
+            return 0;
+        }
+        saved++;
+    }
+
+    free(buffer);
+    printf("✅ Saved %d channel stems (%d silent channels skipped)\n", saved, STEM_CHANNELS - saved);
     return 1;
 }
+
+#endif // WAV_WRITER_H
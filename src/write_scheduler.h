@@ -0,0 +1,169 @@
+#ifndef WRITE_SCHEDULER_H
+#define WRITE_SCHEDULER_H
+
+#include "events.h"
+#include "sample_clock.h"
+
+// Busy-flag write scheduler
+// Issues pass1 register writes inside the clock loop the way a sound driver does: wait until the
+// busy flag (OPM_Read bit 7) is clear, write the address, let the chip latch it, write the data.
+// A write then costs about SCHEDULER_CYCLES_PER_WRITE clocks (~0.6 samples) instead of the fixed
+// 2 * DELAY_SAMPLES (4 samples) of convert_to_pass2_format, so bulk uploads finish as fast as the
+// chip allows and note-on timing stays tight.
+
+#define SCHEDULER_WRITE_GAP_CYCLES 2   // Clocks until the chip has latched write_data (shared by both ports)
+#define SCHEDULER_BUSY_DELAY_CYCLES 2  // Clocks after a data write until the busy flag is visible
+#define SCHEDULER_CYCLES_PER_WRITE 40  // Upper estimate of one address+data write incl. busy time
+
+typedef enum
+{
+    SCHEDULER_IDLE = 0,   // Waiting for the next event to become due
+    SCHEDULER_WAIT_READY, // Polling the busy flag before the address write
+    SCHEDULER_ADDRESS     // Address written, data write pending
+} SchedulerState;
+
+typedef struct WriteScheduler
+{
+    RegisterEventList *events; // Pass1 events
+    size_t next_event_index;
+    SchedulerState state;
+    uint32_t wait_cycles;      // Clocks to let pass before the next step
+    RegisterEventList *issued; // Actual pass2 write times (preallocated, filled by the audio thread)
+    uint64_t busy_polls;       // Clocks spent waiting for the busy flag
+    double max_delay_samples;  // Longest delay from the requested time to the data write
+} WriteScheduler;
+
+// Create scheduler for pass1 events (the list is not copied)
+WriteScheduler *create_write_scheduler(RegisterEventList *pass1)
+{
+    WriteScheduler *scheduler = (WriteScheduler *)calloc(1, sizeof(WriteScheduler));
+    if (!scheduler)
+    {
+        fprintf(stderr, "❌ Failed to allocate memory for write scheduler\n");
+        exit(1);
+    }
+    scheduler->events = pass1;
+
+    // Reserve every issued write up front, so the audio thread never reallocates
+    scheduler->issued = create_event_list();
+    if (pass1->count * 2 > scheduler->issued->capacity)
+    {
+        RegisterEvent *events = (RegisterEvent *)realloc(scheduler->issued->events, sizeof(RegisterEvent) * pass1->count * 2);
+        if (!events)
+        {
+            fprintf(stderr, "❌ Failed to allocate memory for issued writes\n");
+            exit(1);
+        }
+        scheduler->issued->events = events;
+        scheduler->issued->capacity = pass1->count * 2;
+    }
+
+    printf("Write scheduler: busy-flag timing for %zu register writes\n\n", pass1->count);
+    return scheduler;
+}
+
+// Free scheduler (not the pass1 events)
+void free_write_scheduler(WriteScheduler *scheduler)
+{
+    free_event_list(scheduler->issued);
+    free(scheduler);
+}
+
+// Time of the last write issued at the latest (for playback duration)
+uint32_t write_scheduler_last_time(const WriteScheduler *scheduler)
+{
+    uint32_t last_time = 0;
+    for (size_t i = 0; i < scheduler->events->count; i++)
+    {
+        if (scheduler->events->events[i].sample_time > last_time)
+        {
+            last_time = scheduler->events->events[i].sample_time;
+        }
+    }
+    // Worst case: every write queued behind all the others
+    return last_time + (uint32_t)((scheduler->events->count * SCHEDULER_CYCLES_PER_WRITE + CYCLES_PER_SAMPLE - 1) / CYCLES_PER_SAMPLE);
+}
+
+// Advance the scheduler by one clock, issuing at most one port write
+// 'clock' is the clock index within the current sample of 'clocks_per_sample'
+static void write_scheduler_step(WriteScheduler *scheduler, opm_t *chip, uint32_t current_sample, uint32_t clock,
+                                 uint32_t clocks_per_sample)
+{
+    if (scheduler->wait_cycles)
+    {
+        scheduler->wait_cycles--;
+        return;
+    }
+
+    RegisterEvent *event = &scheduler->events->events[scheduler->next_event_index];
+    switch (scheduler->state)
+    {
+    case SCHEDULER_IDLE:
+        if (scheduler->next_event_index >= scheduler->events->count || event->sample_time > current_sample)
+        {
+            return;
+        }
+        scheduler->state = SCHEDULER_WAIT_READY;
+        // fall through
+    case SCHEDULER_WAIT_READY:
+        if (OPM_Read(chip, 0) & 0x80)
+        {
+            scheduler->busy_polls++;
+            return;
+        }
+        OPM_Write(chip, OPM_ADDRESS_REGISTER, event->address);
+        add_event_with_flag(scheduler->issued, current_sample, event->address, event->data, 0);
+        scheduler->state = SCHEDULER_ADDRESS;
+        scheduler->wait_cycles = SCHEDULER_WRITE_GAP_CYCLES - 1;
+        return;
+    case SCHEDULER_ADDRESS:
+    {
+        OPM_Write(chip, OPM_DATA_REGISTER, event->data);
+        add_event_with_flag(scheduler->issued, current_sample, event->address, event->data, 1);
+        double delay = (double)(current_sample - event->sample_time) + (double)clock / clocks_per_sample;
+        if (delay > scheduler->max_delay_samples)
+        {
+            scheduler->max_delay_samples = delay;
+        }
+        scheduler->next_event_index++;
+        scheduler->state = SCHEDULER_IDLE;
+        // The busy flag rises a few clocks after the data write, don't poll before that
+        scheduler->wait_cycles = SCHEDULER_BUSY_DELAY_CYCLES;
+        return;
+    }
+    }
+}
+
+// Clock one output sample (see sample_clock.h), issuing due writes at cycle granularity
+void write_scheduler_clock_sample(WriteScheduler *scheduler, opm_t *chip, uint32_t current_sample, int32_t *output,
+                                  uint8_t *strobe_sh1)
+{
+    // Nothing to do for this sample: plain clock loop
+    if (scheduler->state == SCHEDULER_IDLE && scheduler->wait_cycles == 0 &&
+        (scheduler->next_event_index >= scheduler->events->count ||
+         scheduler->events->events[scheduler->next_event_index].sample_time > current_sample))
+    {
+        clock_sample(chip, output, strobe_sh1);
+        return;
+    }
+
+    uint32_t clocks_per_sample = strobe_sh1 ? CYCLES_PER_DAC_LATCH : CYCLES_PER_SAMPLE;
+    uint32_t i = 0;
+    do
+    {
+        write_scheduler_step(scheduler, chip, current_sample, i, clocks_per_sample);
+    } while (!sample_clock_step(chip, output, strobe_sh1, i++));
+}
+
+// Print scheduling statistics (after playback)
+void print_write_scheduler_stats(const WriteScheduler *scheduler)
+{
+    printf("Write scheduler statistics:\n");
+    printf("  Writes issued: %zu / %zu\n", scheduler->issued->count / 2, scheduler->events->count);
+    printf("  Busy-flag wait: %llu clocks (%.2f per write)\n", (unsigned long long)scheduler->busy_polls,
+           scheduler->issued->count ? (double)scheduler->busy_polls * 2 / scheduler->issued->count : 0.0);
+    printf("  Max delay from requested time to data write: %.2f samples (%.3f ms)\n", scheduler->max_delay_samples,
+           scheduler->max_delay_samples * 1000.0 / INTERNAL_SAMPLE_RATE);
+}
+
+#endif // WRITE_SCHEDULER_H
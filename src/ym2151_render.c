@@ -0,0 +1,182 @@
+/* YM2151 render library implementation (API in ym2151_render.h)
+ * Uses the same event conversion, sample generation and format kernels as the player,
+ * so a render at the default format is bit-identical to the player's output.wav.
+ */
+
+#define YM2151_HEADLESS // No audio device: emulation, threads and file IO only
+#include "core.h"
+#include "ym2151_render.h"
+
+// Public format values are the SampleFormat values
+typedef char ym2151_format_check[(YM2151_FORMAT_S16 == SAMPLE_FORMAT_S16 &&
+                                  YM2151_FORMAT_S16_CLIP == SAMPLE_FORMAT_S16_CLIP &&
+                                  YM2151_FORMAT_S24 == SAMPLE_FORMAT_S24 && YM2151_FORMAT_F32 == SAMPLE_FORMAT_F32)
+                                     ? 1
+                                     : -1];
+
+struct ym2151_song
+{
+    RegisterEventList *events; // Pass2
+    uint32_t length;           // Frames (last write + 1 second, as in the player)
+};
+
+struct ym2151_renderer
+{
+    AudioContext ctx;
+    uint8_t mute_mask;
+    int32_t block[INTERNAL_BUFFER_SIZE * 2]; // Raw DAC output before format conversion
+};
+
+uint32_t ym2151_sample_rate(void)
+{
+    return INTERNAL_SAMPLE_RATE;
+}
+
+// Take ownership of pass1 events and build a song, NULL if out of memory
+// Library functions use the try_ event functions: the caller gets NULL instead of the process exiting
+static ym2151_song_t *song_from_pass1(RegisterEventList *pass1)
+{
+    ym2151_song_t *song = (ym2151_song_t *)malloc(sizeof(ym2151_song_t));
+    if (!song)
+    {
+        free_event_list(pass1);
+        return NULL;
+    }
+    song->events = try_split_pass1_events(pass1);
+    free_event_list(pass1);
+    if (!song->events)
+    {
+        free(song);
+        return NULL;
+    }
+
+    uint32_t last_time = 0;
+    for (size_t i = 0; i < song->events->count; i++)
+    {
+        if (song->events->events[i].sample_time > last_time)
+        {
+            last_time = song->events->events[i].sample_time;
+        }
+    }
+    song->length = song->events->count
+                       ? duration_to_samples((double)(last_time + INTERNAL_SAMPLE_RATE) / INTERNAL_SAMPLE_RATE)
+                       : duration_to_samples(1.0);
+    return song;
+}
+
+ym2151_song_t *ym2151_song_from_json(const char *json, size_t size)
+{
+    // The parser needs a terminated string
+    char *text = (char *)malloc(size + 1);
+    if (!text)
+    {
+        return NULL;
+    }
+    memcpy(text, json, size);
+    text[size] = '\0';
+    RegisterEventList *pass1 = parse_events_json_pass1_parallel(text, size, 0);
+    free(text);
+    if (!pass1)
+    {
+        return NULL;
+    }
+    if (pass1->count == 0) // Not a log, or no event with "time", "addr" and "data"
+    {
+        free_event_list(pass1);
+        return NULL;
+    }
+    return song_from_pass1(pass1);
+}
+
+ym2151_song_t *ym2151_song_from_writes(const ym2151_write_t *writes, size_t count)
+{
+    RegisterEventList *pass1 = try_create_event_list();
+    if (!pass1)
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!try_add_event_with_flag(pass1, writes[i].time, writes[i].address, writes[i].data, 0))
+        {
+            free_event_list(pass1);
+            return NULL;
+        }
+    }
+    if (try_sort_events_by_time(pass1) < 0)
+    {
+        free_event_list(pass1);
+        return NULL;
+    }
+    return song_from_pass1(pass1);
+}
+
+uint32_t ym2151_song_length(const ym2151_song_t *song)
+{
+    return song->length;
+}
+
+void ym2151_song_free(ym2151_song_t *song)
+{
+    if (song)
+    {
+        free_event_list(song->events);
+        free(song);
+    }
+}
+
+ym2151_renderer_t *ym2151_renderer_create(void)
+{
+    // Zeroed context: total_samples = 0, so render returns 0 until a song is started
+    return (ym2151_renderer_t *)calloc(1, sizeof(ym2151_renderer_t));
+}
+
+void ym2151_renderer_free(ym2151_renderer_t *renderer)
+{
+    free(renderer);
+}
+
+void ym2151_renderer_start(ym2151_renderer_t *renderer, const ym2151_song_t *song)
+{
+    AudioContext *ctx = &renderer->ctx;
+    OPM_Reset(&ctx->chip);
+    OPM_SetMuteMask(&ctx->chip, renderer->mute_mask);
+    ctx->events = song->events; // Only read during rendering
+    ctx->next_event_index = 0;
+    ctx->samples_played = 0;
+    ctx->total_samples = song->length;
+}
+
+void ym2151_renderer_set_mute_mask(ym2151_renderer_t *renderer, uint8_t mask)
+{
+    renderer->mute_mask = mask;
+    OPM_SetMuteMask(&renderer->ctx.chip, mask);
+}
+
+size_t ym2151_renderer_render(ym2151_renderer_t *renderer, void *out, size_t frames, int format)
+{
+    AudioContext *ctx = &renderer->ctx;
+    SampleFormat sample_format = (SampleFormat)format;
+    size_t bytes_per_frame = 2 * sample_format_bytes(sample_format);
+    size_t rendered = 0;
+    while (rendered < frames && ctx->samples_played < ctx->total_samples)
+    {
+        size_t count = frames - rendered;
+        if (count > INTERNAL_BUFFER_SIZE)
+        {
+            count = INTERNAL_BUFFER_SIZE;
+        }
+        if (count > ctx->total_samples - ctx->samples_played)
+        {
+            count = ctx->total_samples - ctx->samples_played;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            generate_sample(ctx, &renderer->block[i * 2]);
+            ctx->samples_played++;
+        }
+        convert_samples(sample_format, renderer->block, (uint8_t *)out + rendered * bytes_per_frame, count * 2);
+        rendered += count;
+    }
+    return rendered;
+}
@@ -0,0 +1,55 @@
+/* YM2151 render library
+ * Embeddable C API for rendering register logs without the player process:
+ * load events from memory, render into caller-provided buffers block by block,
+ * and reuse songs and renderers across any number of renders.
+ * Build: python3 build.py build-lib -> libym2151render.a (includes the emulator, link with -lm -lpthread)
+ */
+#ifndef _YM2151_RENDER_H_
+#define _YM2151_RENDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Output formats (interleaved stereo) */
+#define YM2151_FORMAT_S16 0      /* int16, DAC output halved (same as the player's default) */
+#define YM2151_FORMAT_S16_CLIP 1 /* int16, full DAC range with saturation */
+#define YM2151_FORMAT_S24 2      /* packed little-endian 24-bit, 3 bytes per value */
+#define YM2151_FORMAT_F32 3      /* float, 1.0 = 32768 */
+
+/* One pass1 register write (time in samples at ym2151_sample_rate()) */
+typedef struct {
+    uint32_t time;
+    uint8_t address;
+    uint8_t data;
+} ym2151_write_t;
+
+typedef struct ym2151_song ym2151_song_t;         /* Parsed register log, immutable, shareable between renderers */
+typedef struct ym2151_renderer ym2151_renderer_t; /* Chip and playback state, one render at a time */
+
+uint32_t ym2151_sample_rate(void);
+
+/* Songs: from a JSON log in memory (same format as the player input) or from an array of writes
+ * (writes in any time order; writes with the same time keep their order)
+ * Both return NULL if out of memory; ym2151_song_from_json also if the text holds no complete event */
+ym2151_song_t *ym2151_song_from_json(const char *json, size_t size);
+ym2151_song_t *ym2151_song_from_writes(const ym2151_write_t *writes, size_t count);
+uint32_t ym2151_song_length(const ym2151_song_t *song); /* Frames until one second after the last write */
+void ym2151_song_free(ym2151_song_t *song);
+
+/* Renderers */
+ym2151_renderer_t *ym2151_renderer_create(void); /* NULL if out of memory */
+void ym2151_renderer_free(ym2151_renderer_t *renderer);
+void ym2151_renderer_start(ym2151_renderer_t *renderer, const ym2151_song_t *song); /* Resets the chip */
+void ym2151_renderer_set_mute_mask(ym2151_renderer_t *renderer, uint8_t mask);   /* Bit n mutes channel n+1 */
+/* Render up to 'frames' frames into 'out', returns the number rendered (0 at the end of the song) */
+size_t ym2151_renderer_render(ym2151_renderer_t *renderer, void *out, size_t frames, int format);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif